@@ -24,6 +24,7 @@ struct session_s {
   char *rx_valid;
   char *rx_ready;
   char *sys_clk;
+  clk_edge_state_t edge;
   tapcfg_t *tapcfg;
   int fd;
   char databuf[2000];
@@ -202,12 +203,11 @@ out:
 
 static int ethernet_tick(void *sess, uint64_t time_ps)
 {
-  static clk_edge_state_t edge;
   char c;
   struct session_s *s = (struct session_s*)sess;
   struct eth_packet_s *pep;
 
-  if(!clk_pos_edge(&edge, *s->sys_clk)) {
+  if(!clk_pos_edge(&s->edge, *s->sys_clk)) {
     return RC_OK;
   }
 
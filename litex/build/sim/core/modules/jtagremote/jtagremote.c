@@ -16,6 +16,7 @@ struct session_s {
 	char *tck;
 	char *tms;
 	char *sys_clk;
+	clk_edge_state_t edge;
 	struct event *ev;
 	char databuf[2048];
 	int data_start;
@@ -210,12 +211,11 @@ out:
 }
 static int jtagremote_tick(void *sess, uint64_t time_ps)
 {
-  static clk_edge_state_t edge;
 	char c, val;
 	int ret = RC_OK;
 
   struct session_s *s = (struct session_s*)sess;
-  if(!clk_pos_edge(&edge, *s->sys_clk)) {
+  if(!clk_pos_edge(&s->edge, *s->sys_clk)) {
     return RC_OK;
   }
 
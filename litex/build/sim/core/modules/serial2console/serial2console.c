@@ -7,9 +7,21 @@
 #include <event2/util.h>
 #include <event2/event.h>
 #include <termios.h>
+#include <inttypes.h>
 
+#include <json-c/json.h>
 #include "modules.h"
 
+/* Console output is buffered and flushed on newline, when the buffer is full or when the SoC has
+ * not transmitted for "flush_idle" sys_clk cycles (optional module arg, default 10000 cycles).
+ * With the optional "log" module arg, the output is also written to a file, each line prefixed
+ * with the sys_clk cycle at which it started. */
+#define OUTBUF_SIZE        4096
+#define OUTBUF_FLUSH_IDLE  10000
+
+/* Input ring buffer: stdin is no longer read when it is full (until half of it is consumed). */
+#define DATABUF_SIZE       2048
+
 struct session_s {
   char *tx;
   char *tx_valid;
@@ -18,13 +30,39 @@ struct session_s {
   char *rx_valid;
   char *rx_ready;
   char *sys_clk;
+  clk_edge_state_t edge;
   struct event *ev;
-  char databuf[2048];
+  char databuf[DATABUF_SIZE];
   int data_start;
   int datalen;
+  int paused;
+  char outbuf[OUTBUF_SIZE];
+  int outlen;
+  uint64_t cycles;
+  uint64_t last_tx;
+  uint64_t flush_idle;
+  FILE *log;
+  int log_newline;
 };
 
 struct event_base *base;
+
+static int litex_sim_module_get_opt_args(char *args, char *arg, char **val)
+{
+  json_object *jsobj = NULL;
+  json_object *obj = NULL;
+
+  /* Optional arguments: silently return an error when not provided. */
+  *val = NULL;
+  if(!args || !arg)
+    return RC_JSERROR;
+  jsobj = json_tokener_parse(args);
+  if(NULL==jsobj || !json_object_object_get_ex(jsobj, arg, &obj))
+    return RC_JSERROR;
+  *val = strdup(json_object_get_string(obj));
+  return RC_OK;
+}
+
 static int litex_sim_module_pads_get(struct pad_s *pads, char *name, void **signal)
 {
   int ret = RC_OK;
@@ -70,14 +108,46 @@ static int serial2console_start(void *b)
 void read_handler(int fd, short event, void *arg)
 {
   struct session_s *s = (struct session_s*)arg;
-  char buffer[1024];
   ssize_t read_len;
+  int pos, space;
 
-  int i;
-  read_len = read(fd, buffer, 1024);
-  for(i = 0; i < read_len; i++) {
-    s->databuf[(s->data_start + s->datalen ) % 2048] = buffer[i];
-    s->datalen++;
+  /* Only read what fits (contiguous) in the ring buffer, never overwrite unread data. */
+  pos = (s->data_start + s->datalen) % DATABUF_SIZE;
+  space = DATABUF_SIZE - s->datalen;
+  if(space > DATABUF_SIZE - pos)
+    space = DATABUF_SIZE - pos;
+  if(space > 0) {
+    read_len = read(fd, &s->databuf[pos], space);
+    if(read_len > 0)
+      s->datalen += read_len;
+  }
+  if(s->datalen == DATABUF_SIZE) {
+    event_del(s->ev);
+    s->paused = 1;
+  }
+}
+
+static void serial2console_flush(struct session_s *s)
+{
+  if(s->outlen) {
+    fwrite(s->outbuf, 1, s->outlen, stdout);
+    fflush(stdout);
+    s->outlen = 0;
+  }
+}
+
+static void serial2console_output(struct session_s *s, char c)
+{
+  s->outbuf[s->outlen++] = c;
+  s->last_tx = s->cycles;
+  if(c == '\n' || s->outlen == OUTBUF_SIZE)
+    serial2console_flush(s);
+
+  if(s->log) {
+    if(s->log_newline)
+      fprintf(s->log, "[%12" PRIu64 "] ", s->cycles);
+    fputc(c, s->log);
+    s->log_newline = (c == '\n');
   }
 }
 
@@ -93,6 +163,8 @@ static int serial2console_new(void **sess, char *args)
   int ret = RC_OK;
   struct timeval tv = {1, 0};
   struct session_s *s = NULL;
+  char *flush_idle = NULL;
+  char *log = NULL;
 
   if(!sess) {
     ret = RC_INVARG;
@@ -105,10 +177,21 @@ static int serial2console_new(void **sess, char *args)
     goto out;
   }
   memset(s, 0, sizeof(struct session_s));
+  s->flush_idle = OUTBUF_FLUSH_IDLE;
+  if(RC_OK == litex_sim_module_get_opt_args(args, "flush_idle", &flush_idle))
+    s->flush_idle = strtoull(flush_idle, NULL, 0);
+  if(RC_OK == litex_sim_module_get_opt_args(args, "log", &log)) {
+    s->log = fopen(log, "w");
+    if(!s->log)
+      eprintf("Can't open log file: %s\n", log);
+    s->log_newline = 1;
+  }
   s->ev = event_new(base, fileno(stdin), EV_READ | EV_PERSIST , event_handler, s);
   event_add(s->ev, &tv);
 
 out:
+  free(flush_idle);
+  free(log);
   *sess = (void*) s;
   return ret;
 }
@@ -141,36 +224,55 @@ out:
 }
 
 static int serial2console_tick(void *sess, uint64_t time_ps) {
-  static clk_edge_state_t edge;
   struct session_s *s = (struct session_s*)sess;
 
-  if(!clk_pos_edge(&edge, *s->sys_clk)) {
+  if(!clk_pos_edge(&s->edge, *s->sys_clk)) {
     return RC_OK;
   }
 
+  s->cycles++;
+
   *s->tx_ready = 1;
   if(*s->tx_valid) {
-    printf("%c", *s->tx);
-    fflush(stdout);
+    serial2console_output(s, *s->tx);
+  } else if(s->outlen && (s->cycles - s->last_tx) >= s->flush_idle) {
+    serial2console_flush(s);
   }
 
   *s->rx_valid = 0;
   if(s->datalen) {
     *s->rx = s->databuf[s->data_start];
-    s->data_start = (s->data_start + 1) % 2048;
-    s->datalen--;
     *s->rx_valid = 1;
+    if(*s->rx_ready) {
+      s->data_start = (s->data_start + 1) % DATABUF_SIZE;
+      s->datalen--;
+      if(s->paused && s->datalen <= DATABUF_SIZE/2) {
+        struct timeval tv = {1, 0};
+        event_add(s->ev, &tv);
+        s->paused = 0;
+      }
+    }
   }
 
   return RC_OK;
 }
 
+static int serial2console_close(void *sess)
+{
+  struct session_s *s = (struct session_s*)sess;
+
+  serial2console_flush(s);
+  if(s->log)
+    fclose(s->log);
+  return RC_OK;
+}
+
 static struct ext_module_s ext_mod = {
   "serial2console",
   serial2console_start,
   serial2console_new,
   serial2console_add_pads,
-  NULL,
+  serial2console_close,
   serial2console_tick
 };
 
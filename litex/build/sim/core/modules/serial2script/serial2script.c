@@ -0,0 +1,454 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include "error.h"
+#include <event2/util.h>
+#include <event2/event.h>
+
+#include <json-c/json.h>
+#include "modules.h"
+
+/* Scripted serial console for automated/unattended runs.
+ *
+ * Module args:
+ * - "script"  : script file (required).
+ * - "timeout" : simulation timeout in sys_clk cycles (optional, 0: none).
+ * - "log"     : file where timestamped output lines are also written (optional).
+ *
+ * Script commands (one per line, '#' starts a comment):
+ * - expect <string> : wait for <string> in the SoC output.
+ * - send <string>   : send <string> to the SoC (\n, \r, \t, \\ and \xHH escapes supported).
+ * - wait <cycles>   : wait for <cycles> sys_clk cycles.
+ * - timeout <cycles>: (re)arm the timeout, relative to the current cycle.
+ * - exit            : end the simulation.
+ *
+ * Each output line is printed with the sys_clk cycle at which it completed, and each matched
+ * expect reports the number of cycles elapsed since the previous send, giving cycle-accurate
+ * timings of BIOS/firmware commands. The simulation ends at the end of the script or on timeout.
+ */
+
+#define SCRIPT_LINE_MAX   4096
+#define SCRIPT_WINDOW_MAX 1024
+
+enum script_state {
+  SCRIPT_RUN,
+  SCRIPT_EXPECT,
+  SCRIPT_WAIT,
+  SCRIPT_DONE,
+};
+
+struct session_s {
+  char *tx;
+  char *tx_valid;
+  char *tx_ready;
+  char *rx;
+  char *rx_valid;
+  char *rx_ready;
+  char *sys_clk;
+  clk_edge_state_t edge;
+  uint64_t cycles;
+  uint64_t timeout;
+  /* Script */
+  char **lines;
+  int nlines;
+  int pc;
+  enum script_state state;
+  char *expect;
+  int expectlen;
+  uint64_t wait_until;
+  uint64_t last_send;
+  /* Input to the SoC */
+  char *sendbuf;
+  int send_start;
+  int sendlen;
+  /* Output from the SoC */
+  char line[SCRIPT_LINE_MAX];
+  int linelen;
+  char window[SCRIPT_WINDOW_MAX];
+  int windowlen;
+  FILE *log;
+};
+
+static struct event_base *base = NULL;
+
+int litex_sim_module_get_args( char *args, char *arg, char **val)
+{
+  int ret = RC_OK;
+  json_object *jsobj = NULL;
+  json_object *obj = NULL;
+  char *value = NULL;
+  int r;
+
+  if(!arg) {
+    fprintf(stderr, "litex_sim_module_get_args(): `arg` (requested .json key) is NULL!\n");
+    ret=RC_JSERROR;
+    goto out;
+  }
+
+  if(!args) {
+    ret=RC_JSERROR;
+    goto out;
+  }
+
+  jsobj = json_tokener_parse(args);
+  if(NULL==jsobj) {
+    fprintf(stderr, "Error parsing json arg: %s \n", args);
+    ret=RC_JSERROR;
+    goto out;
+  }
+  if(!json_object_is_type(jsobj, json_type_object)) {
+    fprintf(stderr, "Arg must be type object! : %s \n", args);
+    ret=RC_JSERROR;
+    goto out;
+  }
+  obj=NULL;
+  r = json_object_object_get_ex(jsobj, arg, &obj);
+  if(!r) {
+    ret=RC_JSERROR;
+    goto out;
+  }
+  value=strdup(json_object_get_string(obj));
+
+out:
+  *val = value;
+  return ret;
+}
+
+static int litex_sim_module_pads_get(struct pad_s *pads, char *name, void **signal)
+{
+  int ret = RC_OK;
+  void *sig = NULL;
+  int i;
+
+  if(!pads || !name || !signal) {
+    ret = RC_INVARG;
+    goto out;
+  }
+
+  i = 0;
+  while(pads[i].name) {
+    if(!strcmp(pads[i].name, name)) {
+      sig = (void*)pads[i].signal;
+      break;
+    }
+    i++;
+  }
+
+out:
+  *signal = sig;
+  return ret;
+}
+
+static int serial2script_start(void *b)
+{
+  base = (struct event_base *)b;
+  printf("[serial2script] loaded (%p)\n", base);
+  return RC_OK;
+}
+
+static int script_load(struct session_s *s, char *filename)
+{
+  FILE *f;
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t n;
+
+  f = fopen(filename, "r");
+  if(!f) {
+    eprintf("Can't open script file: %s\n", filename);
+    return RC_ERROR;
+  }
+  while((n = getline(&line, &len, f)) != -1) {
+    while(n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+      line[--n] = 0;
+    if(n == 0 || line[0] == '#')
+      continue;
+    s->lines = realloc(s->lines, (s->nlines + 1)*sizeof(char *));
+    if(!s->lines) {
+      fclose(f);
+      return RC_NOENMEM;
+    }
+    s->lines[s->nlines++] = strdup(line);
+  }
+  free(line);
+  fclose(f);
+  return RC_OK;
+}
+
+static char *script_unescape(const char *str, int *len)
+{
+  char *r = malloc(strlen(str) + 1);
+  int i = 0;
+
+  *len = 0;
+  if(!r) {
+    eprintf("Can't allocate script string\n");
+    return NULL;
+  }
+  while(*str) {
+    if(*str == '\\' && str[1]) {
+      str++;
+      switch(*str) {
+        case 'n': r[i++] = '\n'; break;
+        case 'r': r[i++] = '\r'; break;
+        case 't': r[i++] = '\t'; break;
+        case 'x': {
+          char hex[3] = {0};
+          int k;
+          for(k = 0; k < 2 && isxdigit((unsigned char)str[1]); k++)
+            hex[k] = *++str;
+          r[i++] = (char)strtol(hex, NULL, 16);
+          break;
+        }
+        default: r[i++] = *str; break;
+      }
+      str++;
+    } else {
+      r[i++] = *str++;
+    }
+  }
+  *len = i;
+  return r;
+}
+
+static void script_end(struct session_s *s, const char *reason)
+{
+  printf("\n[serial2script] %s at cycle %" PRIu64 ", ending simulation.\n", reason, s->cycles);
+  if(s->log) {
+    fprintf(s->log, "[serial2script] %s at cycle %" PRIu64 "\n", reason, s->cycles);
+    fflush(s->log);
+  }
+  s->state = SCRIPT_DONE;
+  event_base_loopexit(base, NULL);
+}
+
+/* The SoC output can contain NULs: search the window with explicit lengths. */
+static int script_window_find(struct session_s *s)
+{
+  int i;
+
+  for(i = 0; i + s->expectlen <= s->windowlen; i++)
+    if(!memcmp(s->window + i, s->expect, s->expectlen))
+      return 1;
+  return 0;
+}
+
+static void script_match(struct session_s *s)
+{
+  if(s->state != SCRIPT_EXPECT || !script_window_find(s))
+    return;
+  printf("[serial2script] expect \"%s\" matched at cycle %" PRIu64 " (+%" PRIu64 " cycles since last send)\n",
+    s->expect, s->cycles, s->cycles - s->last_send);
+  if(s->log)
+    fprintf(s->log, "[serial2script] expect \"%s\" matched at cycle %" PRIu64 " (+%" PRIu64 " cycles since last send)\n",
+      s->expect, s->cycles, s->cycles - s->last_send);
+  s->windowlen = 0;
+  s->state = SCRIPT_RUN;
+}
+
+static void script_step(struct session_s *s)
+{
+  char *cmd, *arg;
+
+  while(s->state == SCRIPT_RUN && s->sendlen == 0) {
+    if(s->pc >= s->nlines) {
+      script_end(s, "End of script");
+      return;
+    }
+    cmd = s->lines[s->pc++];
+    arg = strchr(cmd, ' ');
+    arg = arg ? arg + 1 : "";
+    if(!strncmp(cmd, "expect ", 7)) {
+      free(s->expect);
+      s->expect = script_unescape(arg, &s->expectlen);
+      if(!s->expect) {
+        script_end(s, "Out of memory");
+        return;
+      }
+      s->expect[s->expectlen] = 0;
+      s->state = SCRIPT_EXPECT;
+      script_match(s);
+    } else if(!strncmp(cmd, "send ", 5)) {
+      free(s->sendbuf);
+      s->sendbuf = script_unescape(arg, &s->sendlen);
+      if(!s->sendbuf) {
+        script_end(s, "Out of memory");
+        return;
+      }
+      s->send_start = 0;
+      s->last_send = s->cycles;
+      s->windowlen = 0;
+    } else if(!strncmp(cmd, "wait ", 5)) {
+      s->wait_until = s->cycles + strtoull(arg, NULL, 0);
+      s->state = SCRIPT_WAIT;
+    } else if(!strncmp(cmd, "timeout ", 8)) {
+      s->timeout = s->cycles + strtoull(arg, NULL, 0);
+    } else if(!strcmp(cmd, "exit")) {
+      script_end(s, "Exit");
+    } else {
+      eprintf("Unknown script command: %s\n", cmd);
+    }
+  }
+}
+
+static void script_output(struct session_s *s, char c)
+{
+  /* Timestamp and print each complete line. */
+  if(c != '\n' && s->linelen < SCRIPT_LINE_MAX - 1)
+    s->line[s->linelen++] = c;
+  if(c == '\n') {
+    s->line[s->linelen] = 0;
+    printf("[%12" PRIu64 "] %s\n", s->cycles, s->line);
+    if(s->log)
+      fprintf(s->log, "[%12" PRIu64 "] %s\n", s->cycles, s->line);
+    s->linelen = 0;
+  }
+
+  /* Match expected string on a sliding window of the output (since the last send/match). */
+  if(s->windowlen == SCRIPT_WINDOW_MAX - 1) {
+    memmove(s->window, s->window + SCRIPT_WINDOW_MAX/2, SCRIPT_WINDOW_MAX/2 - 1);
+    s->windowlen = SCRIPT_WINDOW_MAX/2 - 1;
+  }
+  s->window[s->windowlen++] = c;
+  script_match(s);
+}
+
+static int serial2script_new(void **sess, char *args)
+{
+  int ret = RC_OK;
+  struct session_s *s = NULL;
+  char *script = NULL;
+  char *timeout = NULL;
+  char *log = NULL;
+
+  if(!sess) {
+    ret = RC_INVARG;
+    goto out;
+  }
+  ret = litex_sim_module_get_args(args, "script", &script);
+  if(RC_OK != ret) {
+    eprintf("serial2script requires a \"script\" argument\n");
+    goto out;
+  }
+
+  s = (struct session_s*)malloc(sizeof(struct session_s));
+  if(!s) {
+    ret = RC_NOENMEM;
+    goto out;
+  }
+  memset(s, 0, sizeof(struct session_s));
+
+  ret = script_load(s, script);
+  if(RC_OK != ret)
+    goto out;
+
+  if(RC_OK == litex_sim_module_get_args(args, "timeout", &timeout))
+    s->timeout = strtoull(timeout, NULL, 0);
+  if(RC_OK == litex_sim_module_get_args(args, "log", &log)) {
+    s->log = fopen(log, "w");
+    if(!s->log)
+      eprintf("Can't open log file: %s\n", log);
+  }
+  printf("[serial2script] running %s (%d commands)\n", script, s->nlines);
+
+out:
+  free(script);
+  free(timeout);
+  free(log);
+  *sess = (void*)s;
+  return ret;
+}
+
+static int serial2script_add_pads(void *sess, struct pad_list_s *plist)
+{
+  int ret = RC_OK;
+  struct session_s *s = (struct session_s*)sess;
+  struct pad_s *pads;
+
+  if(!sess || !plist) {
+    ret = RC_INVARG;
+    goto out;
+  }
+  pads = plist->pads;
+  if(!strcmp(plist->name, "serial")) {
+    litex_sim_module_pads_get(pads, "sink_data", (void**)&s->rx);
+    litex_sim_module_pads_get(pads, "sink_valid", (void**)&s->rx_valid);
+    litex_sim_module_pads_get(pads, "sink_ready", (void**)&s->rx_ready);
+    litex_sim_module_pads_get(pads, "source_data", (void**)&s->tx);
+    litex_sim_module_pads_get(pads, "source_valid", (void**)&s->tx_valid);
+    litex_sim_module_pads_get(pads, "source_ready", (void**)&s->tx_ready);
+  }
+
+  if(!strcmp(plist->name, "sys_clk"))
+    litex_sim_module_pads_get(pads, "sys_clk", (void**)&s->sys_clk);
+
+out:
+  return ret;
+}
+
+static int serial2script_tick(void *sess, uint64_t time_ps)
+{
+  struct session_s *s = (struct session_s*)sess;
+
+  if(!clk_pos_edge(&s->edge, *s->sys_clk)) {
+    return RC_OK;
+  }
+  s->cycles++;
+
+  *s->tx_ready = 1;
+  if(*s->tx_valid)
+    script_output(s, *s->tx);
+
+  *s->rx_valid = 0;
+  if(s->sendlen) {
+    *s->rx = s->sendbuf[s->send_start];
+    *s->rx_valid = 1;
+    if(*s->rx_ready) {
+      s->send_start++;
+      s->sendlen--;
+    }
+  }
+
+  if(s->state == SCRIPT_DONE)
+    return RC_OK;
+  if(s->state == SCRIPT_WAIT && s->cycles >= s->wait_until)
+    s->state = SCRIPT_RUN;
+  script_step(s);
+  if(s->state != SCRIPT_DONE && s->timeout && s->cycles >= s->timeout)
+    script_end(s, "Timeout");
+
+  return RC_OK;
+}
+
+static int serial2script_close(void *sess)
+{
+  struct session_s *s = (struct session_s*)sess;
+  int i;
+
+  if(s->log)
+    fclose(s->log);
+  for(i = 0; i < s->nlines; i++)
+    free(s->lines[i]);
+  free(s->lines);
+  free(s->expect);
+  free(s->sendbuf);
+  return RC_OK;
+}
+
+static struct ext_module_s ext_mod = {
+  "serial2script",
+  serial2script_start,
+  serial2script_new,
+  serial2script_add_pads,
+  serial2script_close,
+  serial2script_tick
+};
+
+int litex_sim_ext_module_init(int (*register_module)(struct ext_module_s *))
+{
+  int ret = RC_OK;
+  ret = register_module(&ext_mod);
+  return ret;
+}
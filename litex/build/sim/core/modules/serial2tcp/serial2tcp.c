@@ -1,15 +1,45 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "error.h"
 #include <unistd.h>
+#include <fcntl.h>
 #include <event2/listener.h>
 #include <event2/util.h>
 #include <event2/event.h>
 
+#include <inttypes.h>
+
 #include <json-c/json.h>
 #include "modules.h"
 
+/* Output to the TCP client is buffered and flushed on newline, when the buffer is full or when the
+ * SoC has not transmitted for "flush_idle" sys_clk cycles (optional module arg, default 10000
+ * cycles). With the optional "log" module arg, the output is also written to a file, each line
+ * prefixed with the sys_clk cycle at which it started. */
+#define OUTBUF_SIZE        4096
+#define OUTBUF_FLUSH_IDLE  10000
+
+/* Input from the TCP clients is stored in a ring buffer: when it is full, the clients are no longer
+ * read (TCP backpressure) until the SoC has consumed half of it. Several clients can be connected
+ * at the same time (ex: a logger and an interactive user): the output is sent to all of them and
+ * their input is merged. */
+#define RXBUF_SIZE         (64*1024)
+#define MAX_CLIENTS        8
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct session_s;
+
+struct client_s {
+  int fd;
+  struct event *ev;
+  struct session_s *s;
+};
+
 struct session_s {
   char *tx;
   char *tx_valid;
@@ -18,11 +48,20 @@ struct session_s {
   char *rx_valid;
   char *rx_ready;
   char *sys_clk;
-  struct event *ev;
-  char databuf[2048];
-  int data_start;
-  int datalen;
-  int fd;
+  clk_edge_state_t edge;
+  struct client_s *clients[MAX_CLIENTS];
+  int nclients;
+  int paused;
+  char rxbuf[RXBUF_SIZE];
+  int rx_start;
+  int rxlen;
+  char outbuf[OUTBUF_SIZE];
+  int outlen;
+  uint64_t cycles;
+  uint64_t last_tx;
+  uint64_t flush_idle;
+  FILE *log;
+  int log_newline;
 };
 
 struct event_base *base;
@@ -72,6 +111,22 @@ out:
   return ret;
 }
 
+static int litex_sim_module_get_opt_args(char *args, char *arg, char **val)
+{
+  json_object *jsobj = NULL;
+  json_object *obj = NULL;
+
+  /* Optional arguments: silently return an error when not provided. */
+  *val = NULL;
+  if(!args || !arg)
+    return RC_JSERROR;
+  jsobj = json_tokener_parse(args);
+  if(NULL==jsobj || !json_object_object_get_ex(jsobj, arg, &obj))
+    return RC_JSERROR;
+  *val = strdup(json_object_get_string(obj));
+  return RC_OK;
+}
+
 static int litex_sim_module_pads_get( struct pad_s *pads, char *name, void **signal)
 {
   int ret = RC_OK;
@@ -104,29 +159,101 @@ static int serial2tcp_start(void *b)
   return RC_OK;
 }
 
+static void serial2tcp_remove_client(struct client_s *c)
+{
+  struct session_s *s = c->s;
+  int i;
+
+  for(i = 0; i < s->nclients; i++) {
+    if(s->clients[i] == c) {
+      s->clients[i] = s->clients[--s->nclients];
+      break;
+    }
+  }
+  printf("[serial2tcp] client disconnected (fd %d)\n", c->fd);
+  event_del(c->ev);
+  event_free(c->ev);
+  close(c->fd);
+  free(c);
+}
+
+static void serial2tcp_pause(struct session_s *s, int pause)
+{
+  int i;
+
+  if(s->paused == pause)
+    return;
+  s->paused = pause;
+  for(i = 0; i < s->nclients; i++) {
+    if(pause)
+      event_del(s->clients[i]->ev);
+    else
+      event_add(s->clients[i]->ev, NULL);
+  }
+}
+
 void read_handler(int fd, short event, void *arg)
 {
-  struct session_s *s = (struct session_s*)arg;
-  char buffer[1024];
+  struct client_s *c = (struct client_s*)arg;
+  struct session_s *s = c->s;
   ssize_t read_len;
-  int i, ret;
-
-  read_len = read(fd, buffer, 1024);
-  if (read_len == 0) {
-    // Received EOF, remote has closed the connection
-    ret = event_del(s->ev);
-    if (ret != 0) {
-      eprintf("read_handler(): Error removing event %d!\n", event);
-      return;
+  int pos, space;
+
+  /* Only read what fits (contiguous) in the ring buffer, never overwrite unread data. */
+  pos = (s->rx_start + s->rxlen) % RXBUF_SIZE;
+  space = RXBUF_SIZE - s->rxlen;
+  if(space > RXBUF_SIZE - pos)
+    space = RXBUF_SIZE - pos;
+  if(space == 0) {
+    serial2tcp_pause(s, 1);
+    return;
+  }
+
+  read_len = read(fd, &s->rxbuf[pos], space);
+  if (read_len == 0 || (read_len < 0 && errno != EAGAIN && errno != EINTR)) {
+    // Received EOF/error, remote has closed the connection
+    serial2tcp_remove_client(c);
+    return;
+  }
+  if (read_len > 0)
+    s->rxlen += read_len;
+  if (s->rxlen == RXBUF_SIZE)
+    serial2tcp_pause(s, 1);
+}
+
+static int serial2tcp_flush(struct session_s *s)
+{
+  int ret = RC_OK;
+  int i;
+
+  for(i = 0; i < s->nclients && s->outlen; i++) {
+    if(-1 == send(s->clients[i]->fd, s->outbuf, s->outlen, MSG_NOSIGNAL)) {
+      eprintf("Error writing on socket\n");
+      serial2tcp_remove_client(s->clients[i--]);
     }
-    event_free(s->ev);
-    s->ev = NULL;
   }
-  for(i = 0; i < read_len; i++)
-  {
-    s->databuf[(s->data_start +  s->datalen ) % 2048] = buffer[i];
-    s->datalen++;
+  s->outlen = 0;
+  return ret;
+}
+
+static int serial2tcp_output(struct session_s *s, char c)
+{
+  int ret = RC_OK;
+
+  if(s->log) {
+    if(s->log_newline)
+      fprintf(s->log, "[%12" PRIu64 "] ", s->cycles);
+    fputc(c, s->log);
+    s->log_newline = (c == '\n');
   }
+
+  if(!s->nclients)
+    return ret;
+  s->outbuf[s->outlen++] = c;
+  s->last_tx = s->cycles;
+  if(c == '\n' || s->outlen == OUTBUF_SIZE)
+    ret = serial2tcp_flush(s);
+  return ret;
 }
 
 static void event_handler(int fd, short event, void *arg)
@@ -138,11 +265,29 @@ static void event_handler(int fd, short event, void *arg)
 static void accept_conn_cb(struct evconnlistener *listener, evutil_socket_t fd, struct sockaddr *address, int socklen,  void *ctx)
 {
   struct session_s *s = (struct session_s*)ctx;
-  struct timeval tv = {1, 0};
+  struct client_s *c;
 
-  s->fd = fd;
-  s->ev = event_new(base, fd, EV_READ | EV_PERSIST , event_handler, s);
-  event_add(s->ev, &tv);
+  if(s->nclients == MAX_CLIENTS) {
+    eprintf("Too many clients, rejecting connection\n");
+    close(fd);
+    return;
+  }
+  /* Blocking writes: a slow client throttles the simulation instead of losing output. Reads are
+   * only done when the socket is readable so they never block. */
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+  c = (struct client_s*)malloc(sizeof(struct client_s));
+  if(!c) {
+    close(fd);
+    return;
+  }
+  s->clients[s->nclients++] = c;
+  c->fd = fd;
+  c->s = s;
+  c->ev = event_new(base, fd, EV_READ | EV_PERSIST , event_handler, c);
+  if(!s->paused)
+    event_add(c->ev, NULL);
+  printf("[serial2tcp] client connected (fd %d, %d clients)\n", fd, s->nclients);
 }
 
 static void
@@ -162,6 +307,8 @@ static int serial2tcp_new(void **sess, char *args)
   int port;
   struct evconnlistener *listener;
   struct sockaddr_in sin;
+  char *flush_idle = NULL;
+  char *log = NULL;
 
   if(!sess) {
     ret = RC_INVARG;
@@ -186,6 +333,15 @@ static int serial2tcp_new(void **sess, char *args)
     goto out;
   }
   memset(s, 0, sizeof(struct session_s));
+  s->flush_idle = OUTBUF_FLUSH_IDLE;
+  if(RC_OK == litex_sim_module_get_opt_args(args, "flush_idle", &flush_idle))
+    s->flush_idle = strtoull(flush_idle, NULL, 0);
+  if(RC_OK == litex_sim_module_get_opt_args(args, "log", &log)) {
+    s->log = fopen(log, "w");
+    if(!s->log)
+      eprintf("Can't open log file: %s\n", log);
+    s->log_newline = 1;
+  }
 
   memset(&sin, 0, sizeof(sin));
   sin.sin_family = AF_INET;
@@ -200,6 +356,8 @@ static int serial2tcp_new(void **sess, char *args)
   evconnlistener_set_error_cb(listener, accept_error_cb);
 
 out:
+  free(flush_idle);
+  free(log);
   *sess=(void*)s;
   return ret;
 }
@@ -232,33 +390,38 @@ out:
 }
 static int serial2tcp_tick(void *sess, uint64_t time_ps)
 {
-  static clk_edge_state_t edge;
   char c;
   int ret = RC_OK;
 
   struct session_s *s = (struct session_s*)sess;
-  if(!clk_pos_edge(&edge, *s->sys_clk)) {
+  if(!clk_pos_edge(&s->edge, *s->sys_clk)) {
     return RC_OK;
   }
 
+  s->cycles++;
+
   *s->tx_ready = 1;
-  if(s->fd && *s->tx_valid) {
-    c = *s->tx;
-    if(-1 ==write(s->fd, &c, 1)) {
-      eprintf("Error writing on socket\n");
-      ret = RC_ERROR;
+  if(*s->tx_valid) {
+    ret = serial2tcp_output(s, *s->tx);
+    if(RC_OK != ret)
+      goto out;
+  } else if(s->outlen && (s->cycles - s->last_tx) >= s->flush_idle) {
+    ret = serial2tcp_flush(s);
+    if(RC_OK != ret)
       goto out;
-    }
   }
 
   *s->rx_valid=0;
-  if(s->datalen) {
-    c = s->databuf[s->data_start];
+  if(s->rxlen) {
+    c = s->rxbuf[s->rx_start];
     *s->rx = c;
     *s->rx_valid=1;
     if (*s->rx_ready) {
-      s->data_start = (s->data_start + 1) % 2048;
-      s->datalen--;
+      s->rx_start = (s->rx_start + 1) % RXBUF_SIZE;
+      s->rxlen--;
+      /* Resume reading the clients once half of the buffer is free. */
+      if (s->paused && s->rxlen <= RXBUF_SIZE/2)
+        serial2tcp_pause(s, 0);
     }
   }
 
@@ -266,12 +429,22 @@ out:
   return ret;
 }
 
+static int serial2tcp_close(void *sess)
+{
+  struct session_s *s = (struct session_s*)sess;
+
+  serial2tcp_flush(s);
+  if(s->log)
+    fclose(s->log);
+  return RC_OK;
+}
+
 static struct ext_module_s ext_mod = {
   "serial2tcp",
   serial2tcp_start,
   serial2tcp_new,
   serial2tcp_add_pads,
-  NULL,
+  serial2tcp_close,
   serial2tcp_tick
 };
 
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "error.h"
+
+#include <json-c/json.h>
+#include "modules.h"
+
+/* In-process serial link between sim instances: the serial pads of the two sessions that use the
+ * same "link" name are cross-connected (TX of one to RX of the other) through two FIFOs. The module
+ * is loaded once per process, so the links registry is shared by all the sim instances. */
+
+#define LINK_FIFO_SIZE 4096
+
+struct link_fifo_s {
+  char data[LINK_FIFO_SIZE];
+  int start;
+  int len;
+};
+
+struct link_s {
+  char *name;
+  int nsess;
+  pthread_mutex_t lock;
+  struct link_fifo_s fifo[2];
+  struct link_s *next;
+};
+
+struct session_s {
+  char *tx;
+  char *tx_valid;
+  char *tx_ready;
+  char *rx;
+  char *rx_valid;
+  char *rx_ready;
+  char *sys_clk;
+  clk_edge_state_t edge;
+  struct link_s *link;
+  int side;
+};
+
+static struct link_s *links = NULL;
+static pthread_mutex_t links_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int litex_sim_module_get_args( char *args, char *arg, char **val)
+{
+  int ret = RC_OK;
+  json_object *jsobj = NULL;
+  json_object *obj = NULL;
+  char *value = NULL;
+  int r;
+
+  if(!arg) {
+    fprintf(stderr, "litex_sim_module_get_args(): `arg` (requested .json key) is NULL!\n");
+    ret=RC_JSERROR;
+    goto out;
+  }
+
+  if(!args) {
+    fprintf(stderr, "missing key in .json file: %s\n", arg);
+    ret=RC_JSERROR;
+    goto out;
+  }
+
+  jsobj = json_tokener_parse(args);
+  if(NULL==jsobj) {
+    fprintf(stderr, "Error parsing json arg: %s \n", args);
+    ret=RC_JSERROR;
+    goto out;
+  }
+  if(!json_object_is_type(jsobj, json_type_object)) {
+    fprintf(stderr, "Arg must be type object! : %s \n", args);
+    ret=RC_JSERROR;
+    goto out;
+  }
+  obj=NULL;
+  r = json_object_object_get_ex(jsobj, arg, &obj);
+  if(!r) {
+    fprintf(stderr, "Could not find object: \"%s\" (%s)\n", arg, args);
+    ret=RC_JSERROR;
+    goto out;
+  }
+  value=strdup(json_object_get_string(obj));
+
+out:
+  *val = value;
+  return ret;
+}
+
+static int litex_sim_module_pads_get(struct pad_s *pads, char *name, void **signal)
+{
+  int ret = RC_OK;
+  void *sig = NULL;
+  int i;
+
+  if(!pads || !name || !signal) {
+    ret = RC_INVARG;
+    goto out;
+  }
+
+  i = 0;
+  while(pads[i].name) {
+    if(!strcmp(pads[i].name, name)) {
+      sig = (void*)pads[i].signal;
+      break;
+    }
+    i++;
+  }
+
+out:
+  *signal = sig;
+  return ret;
+}
+
+static struct link_s *seriallink_get_link(char *name)
+{
+  struct link_s *l;
+
+  pthread_mutex_lock(&links_lock);
+  for(l = links; l; l = l->next) {
+    if(!strcmp(l->name, name))
+      goto out;
+  }
+  l = (struct link_s*)malloc(sizeof(struct link_s));
+  if(!l)
+    goto out;
+  memset(l, 0, sizeof(struct link_s));
+  l->name = strdup(name);
+  pthread_mutex_init(&l->lock, NULL);
+  l->next = links;
+  links = l;
+out:
+  pthread_mutex_unlock(&links_lock);
+  return l;
+}
+
+static int seriallink_start(void *b)
+{
+  printf("[seriallink] loaded\n");
+  return RC_OK;
+}
+
+static int seriallink_new(void **sess, char *args)
+{
+  int ret = RC_OK;
+  struct session_s *s = NULL;
+  char *name = NULL;
+
+  if(!sess) {
+    ret = RC_INVARG;
+    goto out;
+  }
+  ret = litex_sim_module_get_args(args, "link", &name);
+  if(RC_OK != ret)
+    goto out;
+
+  s = (struct session_s*)malloc(sizeof(struct session_s));
+  if(!s) {
+    ret = RC_NOENMEM;
+    goto out;
+  }
+  memset(s, 0, sizeof(struct session_s));
+
+  s->link = seriallink_get_link(name);
+  if(!s->link) {
+    ret = RC_NOENMEM;
+    goto out;
+  }
+  if(s->link->nsess >= 2) {
+    ret = RC_ERROR;
+    eprintf("Link %s already has 2 endpoints\n", name);
+    goto out;
+  }
+  s->side = s->link->nsess++;
+  printf("[seriallink] endpoint %d of link %s\n", s->side, name);
+
+out:
+  free(name);
+  *sess = (void*)s;
+  return ret;
+}
+
+static int seriallink_add_pads(void *sess, struct pad_list_s *plist)
+{
+  int ret = RC_OK;
+  struct session_s *s = (struct session_s*)sess;
+  struct pad_s *pads;
+
+  if(!sess || !plist) {
+    ret = RC_INVARG;
+    goto out;
+  }
+  pads = plist->pads;
+  if(!strcmp(plist->name, "serial")) {
+    litex_sim_module_pads_get(pads, "sink_data", (void**)&s->rx);
+    litex_sim_module_pads_get(pads, "sink_valid", (void**)&s->rx_valid);
+    litex_sim_module_pads_get(pads, "sink_ready", (void**)&s->rx_ready);
+    litex_sim_module_pads_get(pads, "source_data", (void**)&s->tx);
+    litex_sim_module_pads_get(pads, "source_valid", (void**)&s->tx_valid);
+    litex_sim_module_pads_get(pads, "source_ready", (void**)&s->tx_ready);
+  }
+
+  if(!strcmp(plist->name, "sys_clk"))
+    litex_sim_module_pads_get(pads, "sys_clk", (void**)&s->sys_clk);
+
+out:
+  return ret;
+}
+
+static int seriallink_tick(void *sess, uint64_t time_ps)
+{
+  struct session_s *s = (struct session_s*)sess;
+  struct link_fifo_s *txf, *rxf;
+
+  if(!clk_pos_edge(&s->edge, *s->sys_clk)) {
+    return RC_OK;
+  }
+
+  /* Our TX feeds the FIFO read by the other side. */
+  txf = &s->link->fifo[s->side];
+  rxf = &s->link->fifo[!s->side];
+
+  pthread_mutex_lock(&s->link->lock);
+  *s->tx_ready = txf->len < LINK_FIFO_SIZE;
+  if(*s->tx_ready && *s->tx_valid) {
+    txf->data[(txf->start + txf->len) % LINK_FIFO_SIZE] = *s->tx;
+    txf->len++;
+  }
+
+  *s->rx_valid = 0;
+  if(rxf->len) {
+    *s->rx = rxf->data[rxf->start];
+    *s->rx_valid = 1;
+    if(*s->rx_ready) {
+      rxf->start = (rxf->start + 1) % LINK_FIFO_SIZE;
+      rxf->len--;
+    }
+  }
+  pthread_mutex_unlock(&s->link->lock);
+
+  return RC_OK;
+}
+
+static struct ext_module_s ext_mod = {
+  "seriallink",
+  seriallink_start,
+  seriallink_new,
+  seriallink_add_pads,
+  NULL,
+  seriallink_tick
+};
+
+int litex_sim_ext_module_init(int (*register_module)(struct ext_module_s *))
+{
+  int ret = RC_OK;
+  ret = register_module(&ext_mod);
+  return ret;
+}
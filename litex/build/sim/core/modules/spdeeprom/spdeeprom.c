@@ -46,6 +46,7 @@ enum TransactionState {
 struct session_s {
   // DUT pads (need separate SDA io/out as Verilator does not support tristate pins)
   char *sys_clk;
+  clk_edge_state_t edge;
   char *sda_in;
   char *sda_out;
   char *scl;
@@ -59,6 +60,9 @@ struct session_s {
   unsigned int bit_counter;
   unsigned int devaddr;
   unsigned int addr;
+  // bus lines previous state
+  int sda_last;
+  int scl_last;
 };
 
 // Module interface
@@ -117,6 +121,8 @@ static int spdeeprom_new(void **sess, char *args)
     goto out;
   }
   memset(s, 0, sizeof(struct session_s));
+  s->sda_last = 1;
+  s->scl_last = 1;
 
   spd_filename = getenv("SPD_EEPROM_FILE");
   if (spd_filename != NULL) {
@@ -164,14 +170,13 @@ out:
 
 static int spdeeprom_tick(void *sess, uint64_t time_ps)
 {
-  static clk_edge_state_t edge;
   struct session_s *s = (struct session_s*) sess;
 
   if (s->sda_in == 0 || s->sda_out == 0 || s->scl == 0) {
       return RC_OK;
   }
 
-  if(!clk_pos_edge(&edge, *s->sys_clk)) {
+  if(!clk_pos_edge(&s->edge, *s->sys_clk)) {
     return RC_OK;
   }
 
@@ -210,9 +215,6 @@ static inline const char *state_transaction_str(enum TransactionState s)
 
 static void fsm_tick(struct session_s *s)
 {
-  static int sda_last = 1;
-  static int scl_last = 1;
-
   enum SerialState last_state_serial;
   int sda_rising_edge;
   int sda_falling_edge;
@@ -221,15 +223,15 @@ static void fsm_tick(struct session_s *s)
   int scl_rising;
   int scl_falling;
 
-  sda_rising_edge  = !sda_last && *s->sda_out;
-  sda_falling_edge = sda_last && !*s->sda_out;
+  sda_rising_edge  = !s->sda_last && *s->sda_out;
+  sda_falling_edge = s->sda_last && !*s->sda_out;
   start_cond       = sda_falling_edge && *s->scl;
   stop_cond        = sda_rising_edge && *s->scl;
-  scl_rising       = !scl_last && *s->scl;
-  scl_falling      = scl_last && !*s->scl;
+  scl_rising       = !s->scl_last && *s->scl;
+  scl_falling      = s->scl_last && !*s->scl;
 
-  sda_last = *s->sda_out;
-  scl_last = *s->scl;
+  s->sda_last = *s->sda_out;
+  s->scl_last = *s->scl;
 
   if (start_cond) {
     DBG("[spdeeprom] START condition\n");
@@ -53,7 +53,10 @@ int litex_sim_pads_get_list(struct pad_list_s **plist)
     goto out;
   }
 
+  /* Hand over the pads registered by the last initialized model, so that each sim instance gets
+   * its own list. */
   *plist = padlist;
+  padlist = NULL;
 out:
   return ret;
 }
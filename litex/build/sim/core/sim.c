@@ -12,6 +12,8 @@
 #include <sys/socket.h>
 #endif
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "error.h"
 #include "modules.h"
 #include "pads.h"
@@ -20,9 +22,10 @@
 #include <event2/listener.h>
 #include <event2/util.h>
 #include <event2/event.h>
+#include <event2/thread.h>
 
 void litex_sim_init(void **out);
-void litex_sim_dump();
+void litex_sim_dump(void *vsim);
 
 struct session_list_s {
   void *session;
@@ -31,26 +34,32 @@ struct session_list_s {
   struct session_list_s *next;
 };
 
-uint64_t timebase_ps = 1;
-uint64_t sim_time_ps = 0;
-struct session_list_s *sesslist=NULL;
+/* Each simulated SoC (Verilator model + its module sessions) is a sim instance: all the simulation
+ * state lives in it so that several instances can be hosted in the same process. */
+struct sim_instance_s {
+  int id;
+  void *vsim;
+  uint64_t timebase_ps;
+  uint64_t sim_time_ps;
+  struct session_list_s *sesslist;
+  pthread_t thread;
+};
+
+#define SIM_MAX_INSTANCES 64
+#define SIM_STEPS_PER_CB  1000
+
+struct sim_instance_s *instances=NULL;
+int ninstances = 1;
+int parallel = 0;
+struct ext_module_list_s *mlist=NULL;
 struct event_base *base=NULL;
 
-static int litex_sim_initialize_all(void **sim, void *base)
+static int litex_sim_load_all(void *base)
 {
-  struct module_s *ml=NULL;
-  struct module_s *mli=NULL;
-  struct ext_module_list_s *mlist=NULL;
   struct ext_module_list_s *pmlist=NULL;
-  //struct ext_module_list_s *mlisti=NULL;
-  struct pad_list_s *plist=NULL;
-  struct pad_list_s *pplist=NULL;
-  struct session_list_s *slist=NULL;
-  void *vsim=NULL;
-  int i;
   int ret = RC_OK;
 
-  /* Load external modules */
+  /* Load external modules (once per process, shared by all instances) */
   ret = litex_sim_load_ext_modules(&mlist);
   if(RC_OK != ret)
   {
@@ -63,9 +72,30 @@ static int litex_sim_initialize_all(void **sim, void *base)
       pmlist->module->start(base);
     }
   }
+out:
+  return ret;
+}
 
-  /* Load configuration */
-  ret = litex_sim_file_parse("sim_config.js", &ml, &timebase_ps);
+static int litex_sim_initialize_instance(struct sim_instance_s *inst)
+{
+  struct module_s *ml=NULL;
+  struct module_s *mli=NULL;
+  struct ext_module_list_s *pmlist=NULL;
+  struct pad_list_s *plist=NULL;
+  struct pad_list_s *pplist=NULL;
+  struct session_list_s *slist=NULL;
+  char config[64];
+  void *vsim=NULL;
+  int i;
+  int ret = RC_OK;
+
+  /* Load configuration (sim_config<id>.js when provided, else the shared sim_config.js) */
+  snprintf(config, sizeof(config), "sim_config%d.js", inst->id);
+  if((ninstances == 1) || access(config, R_OK))
+  {
+    strcpy(config, "sim_config.js");
+  }
+  ret = litex_sim_file_parse(config, &ml, &inst->timebase_ps);
   if(RC_OK != ret)
   {
     goto out;
@@ -73,7 +103,8 @@ static int litex_sim_initialize_all(void **sim, void *base)
   /* Init generated */
   litex_sim_init(&vsim);
 
-  /* Get pads from generated */
+  /* Get pads from generated (pads are registered per model, sessions must be created before the
+   * next model is initialized) */
   ret = litex_sim_pads_get_list(&plist);
   if(RC_OK != ret)
   {
@@ -106,13 +137,13 @@ static int litex_sim_initialize_all(void **sim, void *base)
 
     slist->tickfirst = mli->tickfirst;
     slist->module = pmlist->module;
-    slist->next = sesslist;
+    slist->next = inst->sesslist;
     ret = pmlist->module->new_sess(&slist->session, mli->args);
     if(RC_OK != ret)
     {
       goto out;
     }
-    sesslist = slist;
+    inst->sesslist = slist;
 
     /* For each interface */
     for(i = 0; i < mli->niface; i++)
@@ -136,28 +167,28 @@ static int litex_sim_initialize_all(void **sim, void *base)
       }
     }
   }
-  *sim = vsim;
+  inst->vsim = vsim;
 out:
   return ret;
 }
 
-int litex_sim_sort_session()
+int litex_sim_sort_session(struct sim_instance_s *inst)
 {
   struct session_list_s *s;
-  struct session_list_s *sprev=sesslist;
+  struct session_list_s *sprev=inst->sesslist;
 
-  if(!sesslist->next)
+  if(!inst->sesslist->next)
   {
     return RC_OK;
   }
 
-  for(s = sesslist->next; s; s=s->next)
+  for(s = inst->sesslist->next; s; s=s->next)
   {
     if(s->tickfirst)
     {
       sprev->next = s->next;
-      s->next = sesslist;
-      sesslist=s;
+      s->next = inst->sesslist;
+      inst->sesslist=s;
       s=sprev;
       continue;
     }
@@ -167,41 +198,139 @@ int litex_sim_sort_session()
   return RC_OK;
 }
 
-struct event *ev;
-
-static void cb(int sock, short which, void *arg)
+static void *litex_sim_run_instance(void *arg)
 {
+  struct sim_instance_s *inst = (struct sim_instance_s *)arg;
   struct session_list_s *s;
-  void *vsim=arg;
-  struct timeval tv;
-  tv.tv_sec = 0;
-  tv.tv_usec = 0;
   int i;
 
-  for(i = 0; i < 1000; i++)
+  for(i = 0; i < SIM_STEPS_PER_CB; i++)
   {
-    for(s = sesslist; s; s=s->next)
+    for(s = inst->sesslist; s; s=s->next)
     {
       if(s->tickfirst)
-        s->module->tick(s->session, sim_time_ps);
+        s->module->tick(s->session, inst->sim_time_ps);
     }
 
-    litex_sim_eval(vsim, sim_time_ps);
-    litex_sim_dump();
+    litex_sim_eval(inst->vsim, inst->sim_time_ps);
+    litex_sim_dump(inst->vsim);
 
-    for(s = sesslist; s; s=s->next)
+    for(s = inst->sesslist; s; s=s->next)
     {
       if(!s->tickfirst)
-        s->module->tick(s->session, sim_time_ps);
+        s->module->tick(s->session, inst->sim_time_ps);
     }
 
-    sim_time_ps += timebase_ps;
+    inst->sim_time_ps += inst->timebase_ps;
+
+    if (litex_sim_got_finish())
+      break;
+  }
+
+  return NULL;
+}
+
+/* With --parallel, each instance is stepped by its own (persistent) worker thread: the main thread
+ * starts a batch (new generation) and waits for all the workers to complete it. */
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t batch_done = PTHREAD_COND_INITIALIZER;
+static unsigned int batch_gen = 0;
+static int batch_pending = 0;
+static int batch_stop = 0;
+static int workers = 0;
+
+static void *litex_sim_worker(void *arg)
+{
+  struct sim_instance_s *inst = (struct sim_instance_s *)arg;
+  unsigned int gen = 0;
+
+  for(;;)
+  {
+    pthread_mutex_lock(&batch_lock);
+    while((batch_gen == gen) && !batch_stop)
+      pthread_cond_wait(&batch_start, &batch_lock);
+    if(batch_stop)
+    {
+      pthread_mutex_unlock(&batch_lock);
+      break;
+    }
+    gen = batch_gen;
+    pthread_mutex_unlock(&batch_lock);
+
+    litex_sim_run_instance(inst);
+
+    pthread_mutex_lock(&batch_lock);
+    if(--batch_pending == 0)
+      pthread_cond_signal(&batch_done);
+    pthread_mutex_unlock(&batch_lock);
+  }
+
+  return NULL;
+}
 
-    if (litex_sim_got_finish()) {
-        event_base_loopbreak(base);
-        break;
+static int litex_sim_start_workers(void)
+{
+  for(workers = 0; workers < ninstances; workers++)
+  {
+    if(pthread_create(&instances[workers].thread, NULL, litex_sim_worker, &instances[workers]))
+    {
+      eprintf("Can't create worker thread %d\n", workers);
+      return RC_ERROR;
     }
   }
+  return RC_OK;
+}
+
+static void litex_sim_stop_workers(void)
+{
+  int i;
+
+  pthread_mutex_lock(&batch_lock);
+  batch_stop = 1;
+  pthread_cond_broadcast(&batch_start);
+  pthread_mutex_unlock(&batch_lock);
+  for(i = 0; i < workers; i++)
+    pthread_join(instances[i].thread, NULL);
+  workers = 0;
+}
+
+static void litex_sim_run_batch(void)
+{
+  pthread_mutex_lock(&batch_lock);
+  batch_pending = ninstances;
+  batch_gen++;
+  pthread_cond_broadcast(&batch_start);
+  while(batch_pending)
+    pthread_cond_wait(&batch_done, &batch_lock);
+  pthread_mutex_unlock(&batch_lock);
+}
+
+struct event *ev;
+
+static void cb(int sock, short which, void *arg)
+{
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 0;
+  int i;
+
+  /* Run a batch of steps on each instance (in parallel when requested); instances are synchronized
+   * at the end of each batch, where the event loop also services the modules I/Os. */
+  if(workers)
+  {
+    litex_sim_run_batch();
+  }
+  else
+  {
+    for(i = 0; i < ninstances; i++)
+      litex_sim_run_instance(&instances[i]);
+  }
+
+  if (litex_sim_got_finish()) {
+    event_base_loopbreak(base);
+    return;
+  }
 
   if (!evtimer_pending(ev, NULL)) {
     event_del(ev);
@@ -209,10 +338,48 @@ static void cb(int sock, short which, void *arg)
   }
 }
 
+static void litex_sim_close_all(void)
+{
+  struct session_list_s *s;
+  int i;
+
+  /* Let the modules flush/release their sessions at the end of the simulation */
+  for(i = 0; i < ninstances; i++)
+  {
+    for(s = instances[i].sesslist; s; s=s->next)
+    {
+      if(s->module->close)
+        s->module->close(s->session);
+    }
+  }
+}
+
+static void litex_sim_parse_args(int argc, char *argv[])
+{
+  int i;
+
+  for(i = 1; i < argc; i++)
+  {
+    if(!strncmp(argv[i], "--instances=", 12))
+    {
+      ninstances = atoi(argv[i] + 12);
+    }
+    else if(!strcmp(argv[i], "--parallel"))
+    {
+      parallel = 1;
+    }
+  }
+  if((ninstances < 1) || (ninstances > SIM_MAX_INSTANCES))
+  {
+    eprintf("Invalid number of instances %d, using 1\n", ninstances);
+    ninstances = 1;
+  }
+}
+
 int main(int argc, char *argv[])
 {
-  void *vsim=NULL;
   struct timeval tv;
+  int i;
 
   int ret;
 
@@ -222,6 +389,17 @@ int main(int argc, char *argv[])
 #endif
 
 
+  litex_sim_parse_args(argc, argv);
+
+  /* With --parallel, the modules ticks (running in the instances threads) use the event base
+   * concurrently with the main thread: enable libevent locking. */
+  if(parallel && (evthread_use_pthreads() != 0))
+  {
+    eprintf("Can't enable libevent threads support\n");
+    ret=RC_ERROR;
+    goto out;
+  }
+
   base = event_base_new();
   if(!base)
   {
@@ -231,21 +409,47 @@ int main(int argc, char *argv[])
   }
 
   litex_sim_init_cmdargs(argc, argv);
-  if(RC_OK != (ret = litex_sim_initialize_all(&vsim, base)))
+  if(RC_OK != (ret = litex_sim_load_all(base)))
   {
     goto out;
   }
 
-  if(RC_OK != (ret = litex_sim_sort_session()))
+  instances = (struct sim_instance_s *)calloc(ninstances, sizeof(struct sim_instance_s));
+  if(NULL == instances)
   {
+    ret = RC_NOENMEM;
     goto out;
   }
+  for(i = 0; i < ninstances; i++)
+  {
+    instances[i].id = i;
+    if(RC_OK != (ret = litex_sim_initialize_instance(&instances[i])))
+    {
+      goto out;
+    }
+
+    if(RC_OK != (ret = litex_sim_sort_session(&instances[i])))
+    {
+      goto out;
+    }
+  }
+
+  if(parallel && (ninstances > 1))
+  {
+    if(RC_OK != (ret = litex_sim_start_workers()))
+    {
+      litex_sim_stop_workers();
+      goto out;
+    }
+  }
 
   tv.tv_sec = 0;
   tv.tv_usec = 0;
-  ev = event_new(base, -1, EV_PERSIST, cb, vsim);
+  ev = event_new(base, -1, EV_PERSIST, cb, NULL);
   event_add(ev, &tv);
   event_base_dispatch(base);
+  litex_sim_stop_workers();
+  litex_sim_close_all();
 #if VM_COVERAGE
   litex_sim_coverage_dump();
 #endif
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <atomic>
 #include "Vsim.h"
 #include "verilated.h"
 #ifdef TRACE_FST
@@ -19,14 +20,23 @@ VerilatedVcdC* tfp;
 #endif
 uint64_t tfp_start;
 uint64_t tfp_end;
-uint64_t main_time = 0;
+/* Each sim instance has its own clock: its time is set (per thread) by litex_sim_eval before
+ * evaluating its model, from its worker thread with --parallel or in turn from the main thread,
+ * and returned by sc_time_stamp. Other threads (Verilator --threads) see the time of the first
+ * model. */
+static thread_local int instance_thread = 0;
+static thread_local uint64_t instance_time = 0;
+std::atomic<uint64_t> main_time(0);
 Vsim *g_sim = nullptr;
 
 extern "C" void litex_sim_eval(void *vsim, uint64_t time_ps)
 {
   Vsim *sim = (Vsim*)vsim;
+  instance_thread = 1;
+  instance_time = time_ps;
+  if (g_sim == sim)
+    main_time.store(time_ps, std::memory_order_relaxed);
   sim->eval();
-  main_time = time_ps;
 }
 
 extern "C" void litex_sim_init_cmdargs(int argc, char *argv[])
@@ -37,6 +47,9 @@ extern "C" void litex_sim_init_cmdargs(int argc, char *argv[])
 extern "C" void litex_sim_init_tracer(void *vsim, long start, long end)
 {
   Vsim *sim = (Vsim*)vsim;
+  /* Only the first model (sim instance) is traced. */
+  if (g_sim != nullptr)
+    return;
   tfp_start = start;
   tfp_end = end >= 0 ? end : UINT64_MAX;
   Verilated::traceEverOn(true);
@@ -54,11 +67,14 @@ extern "C" void litex_sim_init_tracer(void *vsim, long start, long end)
   g_sim = sim;
 }
 
-extern "C" void litex_sim_tracer_dump()
+extern "C" void litex_sim_tracer_dump(void *vsim)
 {
   static int last_enabled = 0;
   bool dump_enabled = true;
 
+  if (g_sim != nullptr && g_sim != (Vsim*)vsim)
+    return;
+
   if (g_sim != nullptr) {
     dump_enabled = g_sim->sim_trace != 0 ? true : false;
     if (last_enabled == 0 && dump_enabled) {
@@ -71,8 +87,9 @@ extern "C" void litex_sim_tracer_dump()
     last_enabled = (int) dump_enabled;
   }
 
-  if (dump_enabled && tfp_start <= main_time && main_time <= tfp_end) {
-    tfp->dump((vluint64_t) main_time);
+  uint64_t time = instance_time;
+  if (dump_enabled && tfp_start <= time && time <= tfp_end) {
+    tfp->dump((vluint64_t) time);
   }
 }
 
@@ -90,5 +107,7 @@ extern "C" void litex_sim_coverage_dump()
 
 double sc_time_stamp()
 {
-  return main_time;
+  if (instance_thread)
+    return instance_time;
+  return main_time.load(std::memory_order_relaxed);
 }
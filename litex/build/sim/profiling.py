@@ -0,0 +1,118 @@
+#
+# This file is part of LiteX.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+
+import os
+import re
+import json
+import subprocess
+from shutil import which
+from collections import defaultdict
+
+# Verilator Execution Profiling ---------------------------------------------------------------------
+#
+# When built with --prof-cfuncs, Verilator splits the generated C++ in small functions (one per
+# Verilog statement) and suffixes them with "__PROF__<verilog_module>__l<line>". Combined with a gprof
+# flat profile, this allows mapping the eval cost back to the Verilog statements and, for the LiteX
+# generated top-level, to the Migen module hierarchy of the signals they drive.
+
+_prof_func_re = re.compile(r"__PROF__([A-Za-z_0-9]+)__l?([0-9]+)")
+_gprof_line_re = re.compile(r"^\s*([\d.]+)\s+([\d.]+)\s+([\d.]+)\s+(?:\d+\s+[\d.]+\s+[\d.]+\s+)?(\S.*)$")
+_assign_re = re.compile(r"^\s*(?:assign\s+)?\\?([A-Za-z_][A-Za-z_0-9$]*)(?:\s*\[[^\]]*\])?\s*<?=")
+
+def generate_hierarchy_map(vns, filename="sim_hierarchy.json"):
+    """Save the Verilog signal name -> Migen module hierarchy mapping of the generated design."""
+    hierarchy = {}
+    for sig in list(vns.sigs.keys()):
+        try:
+            name = vns.get_name(sig)
+        except Exception:
+            continue
+        path = [n for n, _ in getattr(sig, "backtrace", [])[:-1]]
+        hierarchy[name] = ".".join(path)
+    with open(filename, "w") as f:
+        json.dump(hierarchy, f, indent=1)
+
+def _get_gprof_flat_profile(binary, gmon):
+    output = subprocess.check_output(["gprof", "-b", "-p", binary, gmon], stderr=subprocess.DEVNULL)
+    r = []
+    for l in output.decode("utf-8").splitlines():
+        m = _gprof_line_re.match(l)
+        if m is not None:
+            r.append((m.group(4), float(m.group(3))))
+    return r
+
+def _get_statement_signal(verilog_lines, line, lookahead=8):
+    for l in verilog_lines[line - 1:line - 1 + lookahead]:
+        m = _assign_re.match(l)
+        if m is not None and m.group(1) not in ["if", "else", "case", "begin", "end"]:
+            return m.group(1)
+    return None
+
+def profile_report(build_name, top_module="sim", depth=2, count=20,
+    binary    = "obj_dir/Vsim",
+    gmon      = "gmon.out",
+    hierarchy = "sim_hierarchy.json",
+    report    = "profile_report.txt"):
+    """Print/save the eval cost of the simulation grouped by LiteX module (from --prof-cfuncs run)."""
+    if which("gprof") is None:
+        print("Unable to find gprof, skipping profiling report.")
+        return
+    if not os.path.exists(gmon):
+        print("No {} found (simulation must exit cleanly), skipping profiling report.".format(gmon))
+        return
+
+    with open(build_name + ".v", "r") as f:
+        verilog_lines = f.readlines()
+    signals = {}
+    if os.path.exists(hierarchy):
+        with open(hierarchy, "r") as f:
+            signals = json.load(f)
+
+    total     = 0.0
+    modules   = defaultdict(float)
+    functions = []
+    for function, self_time in _get_gprof_flat_profile(binary, gmon):
+        total += self_time
+        m = _prof_func_re.search(function)
+        if m is None:
+            # Verilator runtime/sim core/modules functions.
+            location = "<runtime>"
+            module   = "<runtime>"
+        elif m.group(1) != top_module:
+            # Verilog modules instanciated in the design (CPUs, PHYs models, etc...).
+            location = "{}:{}".format(m.group(1), m.group(2))
+            module   = m.group(1)
+        else:
+            # LiteX generated top-level: map statement to its driven signal and Migen hierarchy.
+            line     = int(m.group(2))
+            signal   = _get_statement_signal(verilog_lines, line)
+            location = "{}.v:{} ({})".format(build_name, line, signal)
+            path     = signals.get(signal, "")
+            module   = ".".join(path.split(".")[:depth]) if path else top_module
+        modules[module] += self_time
+        functions.append((self_time, module, location))
+
+    r  = "Simulation profile ({:.2f}s sampled)\n".format(total)
+    r += "\nPer module:\n"
+    r += "{:>8} {:>10}  {}\n".format("%", "self (s)", "module")
+    for module, t in sorted(modules.items(), key=lambda m: m[1], reverse=True)[:count]:
+        r += "{:>7.2f}% {:>10.2f}  {}\n".format(100*t/max(total, 1e-9), t, module)
+    r += "\nHot statements:\n"
+    r += "{:>8} {:>10}  {:<32} {}\n".format("%", "self (s)", "module", "location")
+    for t, module, location in sorted(functions, reverse=True)[:count]:
+        r += "{:>7.2f}% {:>10.2f}  {:<32} {}\n".format(100*t/max(total, 1e-9), t, module, location)
+    print(r)
+    with open(report, "w") as f:
+        f.write(r)
+
+def profile_exec_report(profile="profile_exec.dat"):
+    """Run verilator_gantt on the --prof-exec data of the simulation."""
+    if not os.path.exists(profile):
+        print("No {} found, skipping execution profiling report.".format(profile))
+        return
+    if which("verilator_gantt") is None:
+        print("Unable to find verilator_gantt, {} can be analyzed manually.".format(profile))
+        return
+    subprocess.call(["verilator_gantt", profile])
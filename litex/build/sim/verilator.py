@@ -7,6 +7,7 @@
 
 import os
 import sys
+import hashlib
 import subprocess
 from pathlib import Path
 from shutil import which
@@ -15,6 +16,7 @@ from migen.fhdl.structure import _Fragment
 from litex import get_data_mod
 from litex.build import tools
 from litex.build.generic_platform import *
+from litex.build.sim.profiling import generate_hierarchy_map, profile_report, profile_exec_report
 
 
 sim_directory = os.path.abspath(os.path.dirname(__file__))
@@ -75,14 +77,14 @@ def _generate_sim_cpp(platform, trace=False, trace_start=0, trace_end=-1):
 #include "sim_header.h"
 
 extern "C" void litex_sim_init_tracer(void *vsim, long start, long end);
-extern "C" void litex_sim_tracer_dump();
+extern "C" void litex_sim_tracer_dump(void *vsim);
 
-extern "C" void litex_sim_dump()
+extern "C" void litex_sim_dump(void *vsim)
 {
 """
     if trace:
         content += """\
-    litex_sim_tracer_dump();
+    litex_sim_tracer_dump(vsim);
 """
     content  += """\
 }}
@@ -127,11 +129,35 @@ TAPCFG_DIRECTORY = {}
 
 
 def _generate_sim_config(config):
+    # A list of configs describes several sim instances (SoCs) hosted in the same simulator process.
+    if isinstance(config, list):
+        for i, c in enumerate(config):
+            tools.write_to_file("sim_config{}.js".format(i), c.get_json())
+        config = config[0]
     content = config.get_json()
     tools.write_to_file("sim_config.js", content)
 
 
-def _build_sim(build_name, sources, jobs, threads, coverage, opt_level="O3", trace_fst=False):
+def _get_sim_build_hash(sources, flags):
+    h = hashlib.sha256()
+    # Hash the Verilog/C++ inputs of the Verilator model (memory init files are read at runtime
+    # through $readmemh and are intentionally excluded so firmware changes don't force a rebuild).
+    filenames  = [filename for filename, *_ in sources if Path(filename).suffix not in [".hex", ".init"]]
+    filenames += ["sim_header.h", "sim_init.cpp"]
+    filenames += sorted(str(f) for f in Path(core_directory).iterdir() if f.is_file())
+    for filename in filenames:
+        h.update(filename.encode("utf-8"))
+        with open(filename, "rb") as f:
+            for line in f:
+                # Skip comments (generated files embed the generation date in their banner).
+                if not line.lstrip().startswith(b"//"):
+                    h.update(line)
+    # Hash the build flags.
+    h.update(" ".join(flags).encode("utf-8"))
+    return h.hexdigest()
+
+def _build_sim(build_name, sources, jobs, threads, coverage, opt_level="O3", trace_fst=False, build_cache=True,
+    prof_exec=False, prof_cfuncs=False):
     makefile = os.path.join(core_directory, 'Makefile')
 
     cc_srcs = []
@@ -139,17 +165,37 @@ def _build_sim(build_name, sources, jobs, threads, coverage, opt_level="O3", tra
         if Path(filename).suffix not in [".hex"]:
             cc_srcs.append("--cc " + filename + " ")
 
-    build_script_contents = """\
+    make_args = " ".join(arg for arg in [
+        "CC_SRCS=\"{}\"".format("".join(cc_srcs)),
+        "JOBS={}".format(jobs) if jobs else "",
+        "THREADS={}".format(threads) if int(threads) > 1 else "",
+        "COVERAGE=1" if coverage else "",
+        "OPT_LEVEL={}".format(opt_level),
+        "TRACE_FST=1" if trace_fst else "",
+        "PROF_EXEC=1" if prof_exec else "",
+        "PROF_CFUNCS=1" if prof_cfuncs else "",
+        # Share compiled objects between builds/SoC variants when ccache is available.
+        "OBJCACHE=ccache" if which("ccache") is not None else "",
+    ] if arg)
+
+    if build_cache:
+        # Only re-run Verilator when the generated gateware or the build flags changed, otherwise
+        # reuse the existing obj_dir/Vsim and only rebuild the (incremental) simulation modules.
+        build_hash = _get_sim_build_hash(sources, [make_args])
+        build_script_contents = """\
+if [ -x obj_dir/Vsim ] && [ "$(cat obj_dir/build.hash 2>/dev/null)" = "{hash}" ]; then
+    echo "Verilator model up to date, skipping rebuild."
+    make -C . -f {makefile} modules
+else
+    rm -rf obj_dir/
+    make -C . -f {makefile} {args} && echo "{hash}" > obj_dir/build.hash
+fi
+""".format(hash=build_hash, makefile=makefile, args=make_args)
+    else:
+        build_script_contents = """\
 rm -rf obj_dir/
-make -C . -f {} {} {} {} {} {} {}
-""".format(makefile,
-    "CC_SRCS=\"{}\"".format("".join(cc_srcs)),
-    "JOBS={}".format(jobs) if jobs else "",
-    "THREADS={}".format(threads) if int(threads) > 1 else "",
-    "COVERAGE=1" if coverage else "",
-    "OPT_LEVEL={}".format(opt_level),
-    "TRACE_FST=1" if trace_fst else "",
-    )
+make -C . -f {makefile} {args}
+""".format(makefile=makefile, args=make_args)
     build_script_file = "build_" + build_name + ".sh"
     tools.write_to_file(build_script_file, build_script_contents, force_unix=True)
 
@@ -167,9 +213,13 @@ def _compile_sim(build_name, verbose):
     if verbose:
         print(output)
 
-def _run_sim(build_name, as_root=False, interactive=True):
+def _run_sim(build_name, as_root=False, interactive=True, instances=1, parallel=False):
     run_script_contents = "sudo " if as_root else ""
     run_script_contents += "obj_dir/Vsim"
+    if instances > 1:
+        run_script_contents += " --instances={}".format(instances)
+        if parallel:
+            run_script_contents += " --parallel"
     run_script_file = "run_" + build_name + ".sh"
     tools.write_to_file(run_script_file, run_script_contents, force_unix=True)
     if sys.platform != "win32" and interactive:
@@ -205,6 +255,10 @@ class SimVerilatorToolchain:
             trace_start      = 0,
             trace_end        = -1,
             regular_comb     = False,
+            build_cache      = True,
+            prof_exec        = False,
+            prof_cfuncs      = False,
+            parallel         = False,
             interactive      = True,
             pre_run_callback = None,
             extra_mods       = None,
@@ -243,8 +297,13 @@ class SimVerilatorToolchain:
             if sim_config:
                 _generate_sim_config(sim_config)
 
+            # Generate signals -> Migen hierarchy map (for profiling report)
+            if prof_cfuncs:
+                generate_hierarchy_map(v_output.ns)
+
             # Build
-            _build_sim(build_name, platform.sources, jobs, threads, coverage, opt_level, trace_fst)
+            _build_sim(build_name, platform.sources, jobs, threads, coverage, opt_level, trace_fst, build_cache,
+                prof_exec, prof_cfuncs)
 
         # Run
         if run:
@@ -256,12 +315,24 @@ class SimVerilatorToolchain:
                 msg += "- Add Verilator toolchain to your $PATH."
                 raise OSError(msg)
             _compile_sim(build_name, verbose)
+            sim_configs = sim_config if isinstance(sim_config, list) else [sim_config]
             run_as_root = False
-            if sim_config.has_module("ethernet") \
-               or sim_config.has_module("xgmii_ethernet") \
-               or sim_config.has_module("gmii_ethernet"):
-                run_as_root = True
-            _run_sim(build_name, as_root=run_as_root, interactive=interactive)
+            for config in sim_configs:
+                if config.has_module("ethernet") \
+                   or config.has_module("xgmii_ethernet") \
+                   or config.has_module("gmii_ethernet"):
+                    run_as_root = True
+            _run_sim(build_name,
+                as_root     = run_as_root,
+                interactive = interactive,
+                instances   = len(sim_configs),
+                parallel    = parallel)
+
+            # Profiling reports
+            if prof_cfuncs:
+                profile_report(build_name)
+            if prof_exec:
+                profile_exec_report()
 
         os.chdir(cwd)
 
@@ -277,6 +348,9 @@ def verilator_build_args(parser):
     toolchain_group.add_argument("--trace-start",  default="0",         help="Time to start tracing (ps).")
     toolchain_group.add_argument("--trace-end",    default="-1",        help="Time to end tracing (ps).")
     toolchain_group.add_argument("--opt-level",    default="O3",        help="Compilation optimization level.")
+    toolchain_group.add_argument("--no-build-cache", action="store_true", help="Always rebuild the Verilator model (disable build cache).")
+    toolchain_group.add_argument("--prof-exec",    action="store_true", help="Enable Verilator execution profiling (profile_exec.dat).")
+    toolchain_group.add_argument("--prof-cfuncs",  action="store_true", help="Enable Verilator C functions profiling and per LiteX module report.")
 
 def verilator_build_argdict(args):
     return {
@@ -286,5 +360,8 @@ def verilator_build_argdict(args):
         "trace_fst"   : args.trace_fst,
         "trace_start" : int(float(args.trace_start)),
         "trace_end"   : int(float(args.trace_end)),
-        "opt_level"   : args.opt_level
+        "opt_level"   : args.opt_level,
+        "build_cache" : not args.no_build_cache,
+        "prof_exec"   : args.prof_exec,
+        "prof_cfuncs" : args.prof_cfuncs,
     }
@@ -204,3 +204,47 @@ class WishboneDMAWriter(Module, AutoCSR):
             )
         )
         fsm.act("DONE", self._done.status.eq(1))
+
+# WishboneDMAMem2Mem -------------------------------------------------------------------------------
+
+class WishboneDMAMem2Mem(Module, AutoCSR):
+    """Memory to memory copy/fill.
+
+    A WishboneDMAReader feeding a WishboneDMAWriter through a FIFO, both with their CSRs
+    (base/length/enable/done). In fill mode, the writer writes the fill value (32-bit, replicated
+    to the data width) and the reader is not used. Used by libbase's dma_copy/dma_fill.
+
+    Parameters
+    ----------
+    bus_reader : bus
+        Wishbone bus to read from.
+
+    bus_writer : bus
+        Wishbone bus to write to.
+    """
+    def __init__(self, bus_reader, bus_writer, endianness="little", fifo_depth=16):
+        assert bus_reader.data_width == bus_writer.data_width
+        assert bus_writer.data_width % 32 == 0
+        self.submodules.reader = WishboneDMAReader(bus_reader, endianness=endianness, with_csr=True)
+        self.submodules.writer = WishboneDMAWriter(bus_writer, endianness=endianness, with_csr=True)
+        self._fill       = CSRStorage(description="Fill mode (write fill value instead of read data).")
+        self._fill_value = CSRStorage(32, description="Fill value.")
+
+        # # #
+
+        # FIFO (flushed when the writer is disabled).
+        fifo = stream.SyncFIFO([("data", bus_reader.data_width)], fifo_depth, buffered=True)
+        fifo = ResetInserter()(fifo)
+        self.submodules += fifo
+        self.comb += fifo.reset.eq(~self.writer._enable.storage)
+
+        # Reader -> FIFO -> Writer (or Fill value -> Writer).
+        self.comb += self.reader.source.connect(fifo.sink)
+        self.comb += [
+            If(self._fill.storage,
+                self.writer.sink.valid.eq(1),
+                self.writer.sink.data.eq(Replicate(self._fill_value.storage, bus_writer.data_width//32)),
+            ).Else(
+                fifo.source.connect(self.writer.sink)
+            )
+        ]
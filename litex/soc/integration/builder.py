@@ -85,6 +85,8 @@ class Builder:
         # BIOS.
         bios_lto         = False,
         bios_console     = "full",
+        bios_crc32       = "table",
+        bios_lz4         = False,
 
         # Documentation.
         generate_doc     = False):
@@ -112,6 +114,8 @@ class Builder:
         # BIOS.
         self.bios_lto     = bios_lto
         self.bios_console = bios_console
+        self.bios_crc32   = bios_crc32
+        self.bios_lz4     = bios_lz4
 
         # Documentation.
         self.generate_doc = generate_doc
@@ -167,6 +171,9 @@ class Builder:
         define("LTO", f"{self.bios_lto:d}")
         assert self.bios_console in ["full", "no-history", "no-autocomplete", "lite", "disable"]
         define(f"BIOS_CONSOLE_{self.bios_console.upper()}", "1")
+        assert self.bios_crc32 in ["small", "table", "slice4", "slice8"]
+        define(f"BIOS_CRC32_{self.bios_crc32.upper()}", "1")
+        define("BIOS_LZ4", f"{self.bios_lz4:d}")
 
         return "\n".join(variables_contents)
 
@@ -409,6 +416,8 @@ def builder_args(parser):
     bios_group = parser.add_argument_group(title="BIOS options") # FIXME: Move?
     bios_group.add_argument("--bios-lto",     action="store_true", help="Enable BIOS LTO (Link Time Optimization) compilation.")
     bios_group.add_argument("--bios-console", default="full"  ,    help="Select BIOS console config.", choices=["full", "no-history", "no-autocomplete", "lite", "disable"])
+    bios_group.add_argument("--bios-crc32",   default="table" ,    help="Select BIOS CRC32 implementation (ROM footprint vs speed).", choices=["small", "table", "slice4", "slice8"])
+    bios_group.add_argument("--bios-lz4",     action="store_true", help="Enable BIOS support of LZ4 compressed boot images.")
 
 def builder_argdict(args):
     return {
@@ -427,4 +436,6 @@ def builder_argdict(args):
         "generate_doc"     : args.doc,
         "bios_lto"         : args.bios_lto,
         "bios_console"     : args.bios_console,
+        "bios_crc32"       : args.bios_crc32,
+        "bios_lz4"         : args.bios_lz4,
     }
@@ -1763,6 +1763,26 @@ class LiteXSoC(SoC):
         if SpiNorFlashOpCodes.READ_4_4_4 in module.supported_opcodes:
             self.add_constant("SPIFLASH_MODULE_QPI_CAPABLE")
 
+    # Add DMA --------------------------------------------------------------------------------------
+    def add_dma(self, fifo_depth=16):
+        # Imports.
+        from litex.soc.cores.dma import WishboneDMAMem2Mem
+
+        # Buses (on the main bus: sources can also be outside of main RAM, ex SPI Flash).
+        bus_reader = wishbone.Interface(data_width=self.bus.data_width, adr_width=self.bus.get_address_width(standard="wishbone"))
+        bus_writer = wishbone.Interface(data_width=self.bus.data_width, adr_width=self.bus.get_address_width(standard="wishbone"))
+        self.bus.add_master(name="dma_reader", master=bus_reader)
+        self.bus.add_master(name="dma_writer", master=bus_writer)
+
+        # Core.
+        self.check_if_exists("dma")
+        self.dma = WishboneDMAMem2Mem(
+            bus_reader = bus_reader,
+            bus_writer = bus_writer,
+            endianness = self.cpu.endianness,
+            fifo_depth = fifo_depth,
+        )
+
     # Add SPI SDCard -------------------------------------------------------------------------------
     def add_spi_sdcard(self, name="spisdcard", spi_clk_freq=400e3, with_tristate=False, software_debug=False):
         # Imports.
@@ -25,11 +25,15 @@
 
 #include <libbase/console.h>
 #include <libbase/crc.h>
+#include <libbase/lz4.h>
 #include <libbase/jsmn.h>
 #include <libbase/progress.h>
+#include <libbase/dma.h>
 
 #include <libliteeth/udp.h>
 #include <libliteeth/tftp.h>
+#include <libliteeth/mcast.h>
+#include <libliteeth/helpers.h>
 
 #include <liblitesdcard/spisdcard.h>
 #include <liblitesdcard/sdcard.h>
@@ -43,6 +47,20 @@
 #define max(x, y) (((x) > (y)) ? (x) : (y))
 #define min(x, y) (((x) < (y)) ? (x) : (y))
 
+#if defined(CSR_UART_BASE) || defined(CSR_ETHMAC_BASE)
+static void timer0_load(unsigned int value) {
+	timer0_en_write(0);
+	timer0_reload_write(0);
+#ifndef CONFIG_BIOS_NO_DELAYS
+	timer0_load_write(value);
+#else
+	timer0_load_write(0);
+#endif
+	timer0_en_write(1);
+	timer0_update_value_write(1);
+}
+#endif
+
 /*-----------------------------------------------------------------------*/
 /* Boot                                                                  */
 /*-----------------------------------------------------------------------*/
@@ -80,9 +98,125 @@ void __attribute__((noreturn)) boot(unsigned long r1, unsigned long r2, unsigned
 enum {
 	ACK_TIMEOUT,
 	ACK_CANCELLED,
-	ACK_OK
+	ACK_OK,
+	ACK_OK_V2
 };
 
+/*-----------------------------------------------------------------------*/
+/* Boot Images                                                           */
+/*-----------------------------------------------------------------------*/
+
+/* Boot images are loaded in chunks through boot_image_update(). With BIOS_LZ4, images starting
+   with a LZ4 image header (see litex/tools/litex_lz4img.py) are decompressed on the fly to
+   their address: the compressed data is loaded at the end of the decompressed area (+ margin)
+   and decompressed in place while loaded, the CRC32 is computed over the decompressed data. */
+
+#define LZ4_IMAGE_MAGIC         "LXZ4"
+#define LZ4_IMAGE_HEADER_LEN    16
+#define LZ4_IMAGE_MARGIN(len)   (((len) >> 8) + 64)
+
+struct boot_image {
+	unsigned char *dst;  /* Image address.                     */
+	unsigned char *load; /* Address where to load next chunk.  */
+	int quiet;           /* No messages (serialboot).          */
+#ifdef BIOS_LZ4
+	int compressed;
+	uint32_t length;
+	uint32_t crc;
+	uint32_t got_crc;
+	struct lz4_stream lz4;
+#endif
+};
+
+static void boot_image_init(struct boot_image *img, unsigned long address)
+{
+	memset(img, 0, sizeof(*img));
+	img->dst  = (unsigned char *) address;
+	img->load = img->dst;
+}
+
+#ifdef BIOS_LZ4
+static uint32_t get_le32(const unsigned char *data)
+{
+	return ((uint32_t) data[3] << 24) |
+	       ((uint32_t) data[2] << 16) |
+	       ((uint32_t) data[1] <<  8) |
+	        (uint32_t) data[0];
+}
+
+static int is_lz4_image(const void *data)
+{
+	return memcmp(data, LZ4_IMAGE_MAGIC, 4) == 0;
+}
+
+static unsigned int lz4_image_length(const unsigned char *header)
+{
+	return LZ4_IMAGE_HEADER_LEN + get_le32(header + 8);
+}
+#endif
+
+/* Process len bytes loaded at img->load, returns 0 on error. */
+static int boot_image_update(struct boot_image *img, unsigned int len)
+{
+#ifdef BIOS_LZ4
+	unsigned char *decoded;
+
+	if((img->load == img->dst) && (len >= LZ4_IMAGE_HEADER_LEN) && is_lz4_image(img->load)) {
+		uint32_t compressed_length;
+		unsigned char *src;
+
+		img->compressed   = 1;
+		img->length       = get_le32(img->load + 4);
+		compressed_length = get_le32(img->load + 8);
+		img->crc          = get_le32(img->load + 12);
+		if(!img->quiet)
+			printf("LZ4 image (%ld bytes compressed to %ld bytes).\n",
+				(unsigned long) img->length, (unsigned long) compressed_length);
+
+		/* Move compressed data to the end of the decompressed area */
+		src = img->dst + img->length + LZ4_IMAGE_MARGIN(compressed_length) - compressed_length;
+		if(src < img->dst)
+			src = img->dst;
+		len -= LZ4_IMAGE_HEADER_LEN;
+		memmove(src, img->load + LZ4_IMAGE_HEADER_LEN, len);
+		img->load = src;
+		lz4_stream_init(&img->lz4, img->dst, img->length);
+	}
+
+	if(img->compressed) {
+		decoded = img->lz4.dst;
+		if(lz4_stream_decompress(&img->lz4, img->load, len) < 0) {
+			if(!img->quiet)
+				printf("LZ4 decompression error.\n");
+			return 0;
+		}
+		img->got_crc = crc32_update(img->got_crc, decoded, img->lz4.dst - decoded);
+	}
+#endif
+	img->load += len;
+	return 1;
+}
+
+/* Returns the image length or 0 on error. */
+static unsigned int boot_image_end(struct boot_image *img)
+{
+#ifdef BIOS_LZ4
+	if(img->compressed) {
+		unsigned int length;
+		length = img->lz4.dst - img->dst;
+		if((length != img->length) || (img->got_crc != img->crc)) {
+			if(!img->quiet)
+				printf("LZ4 image check failed (expected %ld bytes/%08lx, got %ld bytes/%08lx).\n",
+					(unsigned long) img->length, (unsigned long) img->crc,
+					(unsigned long) length,      (unsigned long) img->got_crc);
+			return 0;
+		}
+		return length;
+	}
+#endif
+	return img->load - img->dst;
+}
+
 /*-----------------------------------------------------------------------*/
 /* ROM Boot                                                              */
 /*-----------------------------------------------------------------------*/
@@ -108,41 +242,37 @@ void romboot(void)
 #define ACK_TIMEOUT_DELAY CONFIG_CLOCK_FREQUENCY/4
 #define CMD_TIMEOUT_DELAY CONFIG_CLOCK_FREQUENCY/16
 
-static void timer0_load(unsigned int value) {
-	timer0_en_write(0);
-	timer0_reload_write(0);
-#ifndef CONFIG_BIOS_NO_DELAYS
-	timer0_load_write(value);
-#else
-	timer0_load_write(0);
-#endif
-	timer0_en_write(1);
-	timer0_update_value_write(1);
+static int match_magic(const char *str, int recognized, char c)
+{
+	if(c == str[recognized])
+		return recognized + 1;
+	if(c == str[0])
+		return 1;
+	return 0;
 }
 
 static int check_ack(void)
 {
 	int recognized;
+	int recognized_v2;
 	static const char str[SFL_MAGIC_LEN] = SFL_MAGIC_ACK;
+	static const char str_v2[SFL_MAGIC_LEN] = SFL_MAGIC_ACK_V2;
 
 	timer0_load(ACK_TIMEOUT_DELAY);
-	recognized = 0;
+	recognized    = 0;
+	recognized_v2 = 0;
 	while(timer0_value_read()) {
 		if(uart_read_nonblock()) {
 			char c;
 			c = uart_read();
 			if((c == 'Q') || (c == '\e'))
 				return ACK_CANCELLED;
-			if(c == str[recognized]) {
-				recognized++;
-				if(recognized == SFL_MAGIC_LEN)
-					return ACK_OK;
-			} else {
-				if(c == str[0])
-					recognized = 1;
-				else
-					recognized = 0;
-			}
+			recognized = match_magic(str, recognized, c);
+			if(recognized == SFL_MAGIC_LEN)
+				return ACK_OK;
+			recognized_v2 = match_magic(str_v2, recognized_v2, c);
+			if(recognized_v2 == SFL_MAGIC_LEN)
+				return ACK_OK_V2;
 		}
 		timer0_update_value_write(1);
 	}
@@ -157,13 +287,176 @@ static uint32_t get_uint32(unsigned char* data)
 			  (uint32_t) data[3];
 }
 
+static uint16_t get_uint16(unsigned char* data)
+{
+	return ((uint16_t) data[0] << 8) |
+			  (uint16_t) data[1];
+}
+
 #define MAX_FAILURES 256
 
+#ifdef BIOS_LZ4
+/* Decompress in place a LZ4 image loaded (with SFL_CMD_LOAD) at address, returns 0 on error. */
+static int serialboot_lz4(unsigned long address)
+{
+	struct boot_image img;
+
+	if(!is_lz4_image((void *) address))
+		return 0;
+	boot_image_init(&img, address);
+	img.quiet = 1;
+	if(!boot_image_update(&img, lz4_image_length((unsigned char *) address)))
+		return 0;
+	return boot_image_end(&img) != 0;
+}
+#endif
+
+static void sfl_v2_reply(char ack, uint8_t expected)
+{
+	uart_write(ack);
+	uart_write(expected);
+}
+
+/* SFL v2: windowed transfer, frames are executed as they are received (LOAD frames carry their
+   address) and acknowledged with the next expected sequence number. */
+static int serialboot_v2(int flags)
+{
+	static struct sfl_frame_v2 frame;
+	unsigned char *data = (unsigned char *) &frame;
+	uint32_t received;
+	uint8_t expected;
+	uint8_t offset;
+	int failures;
+
+	received = 0;
+	expected = 0;
+	failures = 0;
+	while(1) {
+		int i;
+		int timeout;
+		unsigned int length;
+		uint32_t computed_crc;
+		uint32_t received_crc;
+
+		/* Get one Frame (the timeout is re-armed every 64 bytes) */
+		i = 0;
+		length = 0;
+		timeout = 1;
+		while((i == 0) || timer0_value_read()) {
+			if (uart_read_nonblock()) {
+				unsigned char c;
+				if ((i % 64) == 0)
+					timer0_load(CMD_TIMEOUT_DELAY);
+				c = uart_read();
+				if (i < (int) sizeof(frame))
+					data[i] = c;
+				i++;
+				if (i == SFL_V2_HEADER_LEN)
+					length = get_uint16(frame.payload_length);
+				/* Oversized frames are never completed and end on timeout. */
+				if ((i >= SFL_V2_HEADER_LEN) &&
+				    (length <= SFL_V2_PAYLOAD_MAX) &&
+				    (i == (SFL_V2_HEADER_LEN + length))) {
+					timeout = 0;
+					break;
+				}
+			}
+			timer0_update_value_write(1);
+		}
+
+		/* Check Timeout */
+		if (timeout) {
+			sfl_v2_reply(SFL_ACK_ERROR, expected);
+			continue;
+		}
+
+		/* Check Frame CRC */
+		received_crc = get_uint32(frame.crc);
+		if (flags & SFL_V2_FLAG_CRC32)
+			computed_crc = crc32(&frame.seq, length + 4);
+		else
+			computed_crc = crc16(&frame.seq, length + 4);
+		if(computed_crc != received_crc) {
+			sfl_v2_reply(SFL_ACK_CRCERROR, expected);
+			failures++;
+			if(failures == MAX_FAILURES) {
+				printf("Too many consecutive errors, aborting");
+				return 1;
+			}
+			continue;
+		}
+		failures = 0;
+
+		/* Re-acknowledge duplicates (frames already received or outside of the window) */
+		offset = frame.seq - expected;
+		if((offset >= SFL_V2_WINDOW) || (received & (1UL << offset))) {
+			sfl_v2_reply(SFL_ACK_SUCCESS, expected);
+			continue;
+		}
+
+		/* Execute Frame CMD */
+		switch(frame.cmd) {
+			case SFL_CMD_ABORT:
+				sfl_v2_reply(SFL_ACK_SUCCESS, expected);
+				return 1;
+			case SFL_CMD_LOAD: {
+				char *load_addr;
+				if (length < 4) {
+					sfl_v2_reply(SFL_ACK_ERROR, expected);
+					continue;
+				}
+				load_addr = (char *)(uintptr_t) get_uint32(&frame.payload[0]);
+				memcpy(load_addr, &frame.payload[4], length - 4);
+				break;
+			}
+			case SFL_CMD_JUMP: {
+				/* Only jump once all the previous frames have been received */
+				if ((offset != 0) || (length < 4)) {
+					sfl_v2_reply(SFL_ACK_ERROR, expected);
+					continue;
+				}
+				sfl_v2_reply(SFL_ACK_SUCCESS, expected + 1);
+				boot(0, 0, 0, get_uint32(&frame.payload[0]));
+				break;
+			}
+#ifdef BIOS_LZ4
+			case SFL_CMD_LZ4: {
+				/* Only decompress once all the previous frames have been received */
+				if ((offset != 0) || (length < 4)) {
+					sfl_v2_reply(SFL_ACK_ERROR, expected);
+					continue;
+				}
+				if (!serialboot_lz4(get_uint32(&frame.payload[0]))) {
+					received >>= 1;
+					expected++;
+					sfl_v2_reply(SFL_ACK_UNKNOWN, expected);
+					continue;
+				}
+				break;
+			}
+#endif
+			default:
+				sfl_v2_reply(SFL_ACK_UNKNOWN, expected);
+				continue;
+		}
+
+		/* Slide the window over the contiguous received frames and acknowledge */
+		received |= (1UL << offset);
+		while(received & 1) {
+			received >>= 1;
+			expected++;
+		}
+		sfl_v2_reply(SFL_ACK_SUCCESS, expected);
+	}
+	return 1;
+}
+
 /* Returns 1 if other boot methods should be tried */
 int serialboot(void)
 {
 	struct sfl_frame frame;
 	int failures;
+	static const char str_v2[SFL_MAGIC_LEN+1] = SFL_MAGIC_REQ_V2;
 	static const char str[SFL_MAGIC_LEN+1] = SFL_MAGIC_REQ;
 	const char *c;
 	int ack_status;
@@ -171,7 +464,12 @@ int serialboot(void)
 	printf("Booting from serial...\n");
 	printf("Press Q or ESC to abort boot completely.\n");
 
-	/* Send the serialboot "magic" request to Host and wait for ACK_OK */
+	/* Advertise SFL v2, send the serialboot "magic" request to Host and wait for ACK_OK */
+	c = str_v2;
+	while(*c) {
+		uart_write(*c);
+		c++;
+	}
 	c = str;
 	while(*c) {
 		uart_write(*c);
@@ -186,6 +484,18 @@ int serialboot(void)
 		printf("Cancelled\n");
 		return 0;
 	}
+	if(ack_status == ACK_OK_V2) {
+		/* Get SFL v2 flags */
+		timer0_load(CMD_TIMEOUT_DELAY);
+		while(!uart_read_nonblock()) {
+			timer0_update_value_write(1);
+			if(!timer0_value_read()) {
+				printf("Timeout\n");
+				return 1;
+			}
+		}
+		return serialboot_v2(uart_read());
+	}
 
 	/* Assume ACK_OK */
 	failures = 0;
@@ -280,6 +590,20 @@ int serialboot(void)
 				boot(0, 0, 0, jump_addr);
 				break;
 			}
+#ifdef BIOS_LZ4
+			/* On SFL_CMD_LZ4... */
+			case SFL_CMD_LZ4: {
+				/* Reset failures */
+				failures = 0;
+
+				/* Decompress LZ4 image in place and acknowledge */
+				if (serialboot_lz4(get_uint32(&frame.payload[0])))
+					uart_write(SFL_ACK_SUCCESS);
+				else
+					uart_write(SFL_ACK_ERROR);
+				break;
+			}
+#endif
 			default:
 				/* Increment failures */
 				failures++;
@@ -329,12 +653,21 @@ static int copy_file_from_tftp_to_ram(unsigned int ip, unsigned short server_por
 const char *filename, char *buffer)
 {
 	int size;
+	struct boot_image img;
 	printf("Copying %s to %p... ", filename, buffer);
 	size = tftp_get(ip, server_port, filename, buffer);
 	if(size > 0)
 		printf("(%d bytes)", size);
 	printf("\n");
-	return size;
+	if(size <= 0)
+		return size;
+
+	/* Decompress image (if compressed) */
+	boot_image_init(&img, (unsigned long) buffer);
+	if(!boot_image_update(&img, size))
+		return -1;
+	size = boot_image_end(&img);
+	return (size > 0) ? size : -1;
 }
 
 #ifdef ETH_DYNAMIC_IP
@@ -541,6 +874,39 @@ static void netboot_from_bin(const char * filename, unsigned int ip, unsigned sh
 }
 #endif
 
+/* Start the UDP stack with the local MAC/IP, returns the remote IP. */
+unsigned int eth_udp_start(void)
+{
+	printf("Local IP: %d.%d.%d.%d\n", local_ip[0], local_ip[1], local_ip[2], local_ip[3]);
+	printf("Remote IP: %d.%d.%d.%d\n", remote_ip[0], remote_ip[1], remote_ip[2], remote_ip[3]);
+	udp_start(macadr, IPTOINT(local_ip[0], local_ip[1], local_ip[2], local_ip[3]));
+	return IPTOINT(remote_ip[0], remote_ip[1], remote_ip[2], remote_ip[3]);
+}
+
+#ifdef MAIN_RAM_BASE
+static void netboot_from_mcast(void)
+{
+	int size;
+	struct boot_image img;
+
+	printf("Joining %d.%d.%d.%d:%d...\n",
+		(MCAST_GROUP >> 24) & 0xff, (MCAST_GROUP >> 16) & 0xff,
+		(MCAST_GROUP >>  8) & 0xff, (MCAST_GROUP >>  0) & 0xff, MCAST_PORT);
+	size = mcast_get(MCAST_GROUP, MCAST_PORT, (void *)MAIN_RAM_BASE, MAIN_RAM_SIZE);
+	if (size <= 0)
+		return;
+	printf("(%d bytes)\n", size);
+
+	/* Decompress image (if compressed) */
+	boot_image_init(&img, MAIN_RAM_BASE);
+	if (!boot_image_update(&img, size))
+		return;
+	if (boot_image_end(&img) == 0)
+		return;
+	boot(0, 0, 0, MAIN_RAM_BASE);
+}
+#endif
+
 void netboot(int nb_params, char **params)
 {
 	unsigned int ip;
@@ -557,6 +923,13 @@ void netboot(int nb_params, char **params)
 	ip = IPTOINT(remote_ip[0], remote_ip[1], remote_ip[2], remote_ip[3]);
 	udp_start(macadr, IPTOINT(local_ip[0], local_ip[1], local_ip[2], local_ip[3]));
 
+#ifdef MAIN_RAM_BASE
+	if (filename && (strcmp(filename, "mcast") == 0)) {
+		/* Boot from multicast stream */
+		printf("Booting from multicast...\n");
+		netboot_from_mcast();
+	} else
+#endif
 	if (filename) {
 		printf("Booting from %s (JSON)...\n", filename);
 		netboot_from_json(filename, ip, TFTP_SERVER_PORT);
@@ -576,6 +949,305 @@ void netboot(int nb_params, char **params)
 	printf("Network boot failed.\n");
 }
 
+/*-----------------------------------------------------------------------*/
+/* Network Load                                                          */
+/*-----------------------------------------------------------------------*/
+
+/* UDP bulk memory-write service (see litex/tools/litex_netload.py): the host streams sequenced
+   "write data at address" datagrams, the BIOS writes them directly to memory and acknowledges
+   them with cumulative ACKs (next expected sequence + bitmap of the following ones received);
+   the loaded regions are then verified with their CRC32 before the jump. All fields are
+   big-endian. The CRC32 is computed from the main loop (per NETLOAD_VERIFY_CHUNK), the VERIFY
+   command being acknowledged with a BUSY status until done. Writes overlapping the BIOS RAM are
+   rejected (RANGE status until the next HELLO). */
+
+#ifndef NETLOAD_PORT
+#define NETLOAD_PORT 6070
+#endif
+
+#define NETLOAD_CMD_HELLO  0x00 /* Start of session, resets sequence.              */
+#define NETLOAD_CMD_WRITE  0x01 /* Write payload at address.                       */
+#define NETLOAD_CMD_VERIFY 0x02 /* Verify CRC32 of a region (base, length, crc32). */
+#define NETLOAD_CMD_JUMP   0x03 /* Jump to address.                                */
+#define NETLOAD_CMD_EXIT   0x04 /* End of session, return to the BIOS console.     */
+#define NETLOAD_CMD_ACK    0x80
+
+#define NETLOAD_STATUS_OK      0x00
+#define NETLOAD_STATUS_CRC     0x01 /* CRC error.                          */
+#define NETLOAD_STATUS_MISSING 0x02 /* Sequences missing before command.   */
+#define NETLOAD_STATUS_BUSY    0x03 /* Command in progress (keepalive).    */
+#define NETLOAD_STATUS_RANGE   0x04 /* Write rejected (BIOS RAM).          */
+
+#define NETLOAD_HEADER_LEN   12
+#define NETLOAD_ACK_INTERVAL 16           /* ACK every N in order datagrams. */
+#define NETLOAD_ACK_TIMEOUT  (CONFIG_CLOCK_FREQUENCY/10)
+#define NETLOAD_VERIFY_CHUNK 0x10000      /* Bytes verified per main loop iteration. */
+
+struct netload_header {
+	uint8_t cmd;
+	uint8_t status;
+	uint8_t reserved[2];
+	uint8_t seq[4];
+	uint8_t address[4];
+} __attribute__((packed));
+
+static struct {
+	uint16_t port;
+	uint32_t host_ip;
+	uint16_t host_port;
+	int started;
+	int ack_pending;
+	int finished;
+	uint8_t status;
+	uint32_t expected;     /* Next expected sequence.                          */
+	uint32_t received;     /* Bitmap of the sequences received after expected. */
+	unsigned int since_ack;
+	unsigned long jump;
+	int do_jump;
+	unsigned long total;
+	int range_error;
+	int verifying;         /* VERIFY in progress (not yet acknowledged).        */
+	const unsigned char *verify_ptr;
+	uint32_t verify_left;
+	uint32_t verify_crc;
+	uint32_t verify_got;
+} netload_state;
+
+static void netload_write(uint32_t address, const uint8_t *payload, unsigned int length)
+{
+#ifdef SRAM_BASE
+	if(((uint64_t) address + length > SRAM_BASE) && ((uint64_t) address < (uint64_t) SRAM_BASE + SRAM_SIZE)) {
+		netload_state.range_error = 1;
+		return;
+	}
+#endif
+	memcpy((void *)(uintptr_t) address, payload, length);
+	netload_state.total += length;
+}
+
+/* Sequence done: advance expected (and over the following sequences already received). */
+static void netload_advance(void)
+{
+	netload_state.expected++;
+	while(netload_state.received & 1) {
+		netload_state.received >>= 1;
+		netload_state.expected++;
+	}
+	netload_state.received >>= 1;
+}
+
+static void netload_command(uint8_t cmd, const uint8_t *payload, unsigned int length, uint32_t address)
+{
+	netload_state.status = NETLOAD_STATUS_OK;
+	switch(cmd) {
+		case NETLOAD_CMD_VERIFY:
+			if(length < 12) {
+				netload_state.status = NETLOAD_STATUS_CRC;
+				break;
+			}
+			netload_state.verify_ptr  = (const unsigned char *)(uintptr_t) get_be32(payload + 0);
+			netload_state.verify_left = get_be32(payload + 4);
+			netload_state.verify_crc  = get_be32(payload + 8);
+			netload_state.verify_got  = 0;
+			netload_state.verifying   = 1;
+			netload_state.status      = NETLOAD_STATUS_BUSY;
+			flush_cpu_dcache();
+			flush_l2_cache();
+			break;
+		case NETLOAD_CMD_JUMP:
+			netload_state.jump     = address;
+			netload_state.do_jump  = 1;
+			netload_state.finished = 1;
+			break;
+		case NETLOAD_CMD_EXIT:
+			netload_state.finished = 1;
+			break;
+	}
+}
+
+static void netload_rx_callback(uint32_t src_ip, uint16_t src_port,
+	uint16_t dst_port, void *_data, unsigned int length)
+{
+	const struct netload_header *h = _data;
+	const uint8_t *payload = (const uint8_t *) _data + NETLOAD_HEADER_LEN;
+	uint32_t seq, delta;
+
+	if(dst_port != netload_state.port) return;
+	if(length < NETLOAD_HEADER_LEN) return;
+	length -= NETLOAD_HEADER_LEN;
+	seq = get_be32(h->seq);
+
+	/* Start of session: (re)start from sequence 0 with this host. */
+	if(h->cmd == NETLOAD_CMD_HELLO) {
+		netload_state.host_ip     = src_ip;
+		netload_state.host_port   = src_port;
+		netload_state.started     = 1;
+		netload_state.expected    = 0;
+		netload_state.received    = 0;
+		netload_state.status      = NETLOAD_STATUS_OK;
+		netload_state.since_ack   = 0;
+		netload_state.ack_pending = 1;
+		netload_state.range_error = 0;
+		netload_state.verifying   = 0;
+		return;
+	}
+	if(!netload_state.started) return;
+	if((src_ip != netload_state.host_ip) || (src_port != netload_state.host_port)) return;
+
+	/* Verification in progress: the host only retransmits the VERIFY, ACK (BUSY) again. */
+	if(netload_state.verifying) {
+		netload_state.ack_pending = 1;
+		return;
+	}
+
+	/* Already received: ACK again (our ACK was probably lost). */
+	delta = seq - netload_state.expected;
+	if((int32_t) delta < 0) {
+		netload_state.ack_pending = 1;
+		return;
+	}
+	/* Beyond the bitmap: drop (the host will retransmit). */
+	if(delta > 32) return;
+	if(delta > 0) {
+		/* Out of order: only writes are accepted, commands need all the previous data. */
+		if(h->cmd != NETLOAD_CMD_WRITE) {
+			netload_state.status      = NETLOAD_STATUS_MISSING;
+			netload_state.ack_pending = 1;
+			return;
+		}
+		if(!(netload_state.received & (1UL << (delta - 1)))) {
+			netload_write(get_be32(h->address), payload, length);
+			netload_state.received |= 1UL << (delta - 1);
+			/* Signal the hole to the host. */
+			netload_state.ack_pending = 1;
+		}
+		return;
+	}
+
+	/* In order. */
+	if(h->cmd == NETLOAD_CMD_WRITE) {
+		netload_write(get_be32(h->address), payload, length);
+		netload_state.status = NETLOAD_STATUS_OK;
+	} else {
+		netload_command(h->cmd, payload, length, get_be32(h->address));
+		netload_state.ack_pending = 1;
+		/* VERIFY: sequence done (and acknowledged) at the end of the verification. */
+		if(netload_state.verifying)
+			return;
+	}
+	netload_advance();
+	if(++netload_state.since_ack >= NETLOAD_ACK_INTERVAL)
+		netload_state.ack_pending = 1;
+}
+
+/* Verify the next chunk of the region of the VERIFY in progress. */
+static void netload_verify(void)
+{
+	uint32_t n = min(netload_state.verify_left, NETLOAD_VERIFY_CHUNK);
+
+	netload_state.verify_got   = crc32_update(netload_state.verify_got, netload_state.verify_ptr, n);
+	netload_state.verify_ptr  += n;
+	netload_state.verify_left -= n;
+	if(netload_state.verify_left)
+		return;
+	netload_state.status      = (netload_state.verify_got == netload_state.verify_crc) ?
+		NETLOAD_STATUS_OK : NETLOAD_STATUS_CRC;
+	netload_state.verifying   = 0;
+	netload_state.ack_pending = 1;
+	netload_advance();
+}
+
+static void netload_send_ack(void)
+{
+	struct netload_header *h;
+
+	h = udp_get_tx_buffer();
+	memset(h, 0, sizeof(*h));
+	h->cmd    = NETLOAD_CMD_ACK;
+	h->status = netload_state.range_error ? NETLOAD_STATUS_RANGE : netload_state.status;
+	put_be32(h->seq, netload_state.expected);
+	put_be32(h->address, netload_state.received);
+	udp_send(netload_state.port, netload_state.host_port, sizeof(*h));
+	netload_state.ack_pending = 0;
+	netload_state.since_ack   = 0;
+}
+
+void netload(int nb_params, char **params)
+{
+	uint32_t resolved_ip = 0;
+	unsigned long last_total = 0;
+	char *c;
+	unsigned int port = NETLOAD_PORT;
+
+	if(nb_params > 0) {
+		port = strtoul(params[0], &c, 0);
+		if(*c != 0) {
+			printf("Incorrect port\n");
+			return;
+		}
+	}
+
+	printf("Network load...\n");
+	printf("Local IP: %d.%d.%d.%d\n", local_ip[0], local_ip[1], local_ip[2], local_ip[3]);
+	printf("Listening on UDP port %d, press any key to abort.\n", port);
+
+	memset(&netload_state, 0, sizeof(netload_state));
+	netload_state.port = port;
+	udp_start(macadr, IPTOINT(local_ip[0], local_ip[1], local_ip[2], local_ip[3]));
+	udp_set_callback(netload_rx_callback);
+
+	timer0_load(NETLOAD_ACK_TIMEOUT);
+	while(!netload_state.finished) {
+		/* Exit on key pressed */
+		if(readchar_nonblock()) {
+			printf("Aborted.\n");
+			break;
+		}
+
+		udp_service();
+
+		if(netload_state.verifying)
+			netload_verify();
+
+		/* Resolve host (from the main loop: ARP resolution services the RX path). */
+		if(netload_state.started && (netload_state.host_ip != resolved_ip)) {
+			resolved_ip = netload_state.host_ip;
+			if(!udp_arp_resolve(resolved_ip))
+				resolved_ip = 0;
+			printf("Host %d.%d.%d.%d:%d\n",
+				(int)(resolved_ip >> 24) & 0xff, (int)(resolved_ip >> 16) & 0xff,
+				(int)(resolved_ip >>  8) & 0xff, (int)(resolved_ip >>  0) & 0xff,
+				netload_state.host_port);
+		}
+
+		/* Periodic ACK (when data is received), ensures the host progresses on ACK losses. */
+		timer0_update_value_write(1);
+		if(timer0_value_read() == 0) {
+			if(netload_state.total != last_total) {
+				netload_state.ack_pending = 1;
+				show_progress(-1);
+			}
+			/* Keepalive (BUSY) during verifications. */
+			if(netload_state.verifying)
+				netload_state.ack_pending = 1;
+			last_total = netload_state.total;
+			timer0_load(NETLOAD_ACK_TIMEOUT);
+		}
+
+		if(netload_state.ack_pending && netload_state.started && resolved_ip)
+			netload_send_ack();
+	}
+	/* Final ACK of JUMP/EXIT. */
+	if(netload_state.finished && resolved_ip)
+		netload_send_ack();
+
+	udp_set_callback(NULL);
+	printf("%ld bytes loaded.\n", netload_state.total);
+
+	if(netload_state.do_jump)
+		boot(0, 0, 0, netload_state.jump);
+}
+
 #endif
 
 /*-----------------------------------------------------------------------*/
@@ -584,18 +1256,33 @@ void netboot(int nb_params, char **params)
 
 #ifdef FLASH_BOOT_ADDRESS
 
-static unsigned int check_image_in_flash(unsigned int base_address)
+/* Sanity bound of the image lengths read from flash (erased/corrupted flash). */
+#define FLASH_BOOT_MAX_LENGTH (16*1024*1024)
+
+static uint32_t get_image_length_in_flash(unsigned int base_address)
 {
 	uint32_t length;
-	uint32_t crc;
-	uint32_t got_crc;
 
 	length = MMPTR(base_address);
-	if((length < 32) || (length > 16*1024*1024)) {
+	if((length < 32) || (length > FLASH_BOOT_MAX_LENGTH)) {
 		printf("Error: Invalid image length 0x%08x\n", length);
 		return 0;
 	}
 
+	return length;
+}
+
+#ifndef MAIN_RAM_BASE
+static unsigned int check_image_in_flash(unsigned int base_address)
+{
+	uint32_t length;
+	uint32_t crc;
+	uint32_t got_crc;
+
+	length = get_image_length_in_flash(base_address);
+	if(!length)
+		return 0;
+
 	crc = MMPTR(base_address + 4);
 	got_crc = crc32((unsigned char *)(base_address + 8), length);
 	if(crc != got_crc) {
@@ -605,55 +1292,111 @@ static unsigned int check_image_in_flash(unsigned int base_address)
 
 	return length;
 }
+#endif
 
 #if defined(MAIN_RAM_BASE) && defined(FLASH_BOOT_ADDRESS)
-static int copy_image_from_flash_to_ram(unsigned int flash_address, unsigned long ram_address)
+#ifdef BIOS_LZ4
+/* LZ4 images are written directly to flash (without the length/CRC header of Flash Boot Images). */
+static int copy_lz4_image_from_flash_to_ram(unsigned int flash_address, unsigned long ram_address)
 {
+	struct boot_image img;
 	uint32_t length;
 	uint32_t offset;
 
-	length = check_image_in_flash(flash_address);
-	if(length > 0) {
-		printf("Copying 0x%08x to 0x%08lx (%d bytes)...\n", flash_address, ram_address, length);
-		offset = 0;
-		init_progression_bar(length);
-		while (length > 0) {
-			uint32_t chunk_length;
-			chunk_length = min(length, 0x8000); /* 32KB chunks */
-			memcpy((void *) ram_address + offset, (void*) flash_address + offset + 8, chunk_length);
-			offset += chunk_length;
-			length -= chunk_length;
-			show_progress(offset);
-		}
+	/* Decompressed/compressed lengths (header) */
+	if((get_le32((unsigned char *) flash_address + 4) > FLASH_BOOT_MAX_LENGTH) ||
+	   (get_le32((unsigned char *) flash_address + 8) > FLASH_BOOT_MAX_LENGTH)) {
+		printf("Error: Invalid LZ4 image length 0x%08x/0x%08x\n",
+			get_le32((unsigned char *) flash_address + 4), get_le32((unsigned char *) flash_address + 8));
+		return 0;
+	}
+	length = lz4_image_length((unsigned char *) flash_address);
+	printf("Copying 0x%08x to 0x%08lx (%ld bytes)...\n", flash_address, ram_address, (unsigned long) length);
+	boot_image_init(&img, ram_address);
+	offset = 0;
+	init_progression_bar(length);
+	while (length > 0) {
+		uint32_t chunk_length;
+		chunk_length = min(length, 0x8000); /* 32KB chunks */
+		memcpy(img.load, (void*) flash_address + offset, chunk_length);
+		if (!boot_image_update(&img, chunk_length))
+			return 0;
+		offset += chunk_length;
+		length -= chunk_length;
 		show_progress(offset);
-		printf("\n");
-		return 1;
 	}
+	show_progress(offset);
+	printf("\n");
 
-	return 0;
+	return boot_image_end(&img) != 0;
 }
 #endif
 
-void flashboot(void)
+static int copy_image_from_flash_to_ram(unsigned int flash_address, unsigned long ram_address)
 {
 	uint32_t length;
-	uint32_t result;
+	uint32_t offset;
+	uint32_t crc;
+	uint32_t got_crc;
+	uint32_t chunk_length;
+	uint32_t next_length;
 
-	printf("Booting from flash...\n");
-	length = check_image_in_flash(FLASH_BOOT_ADDRESS);
+#ifdef BIOS_LZ4
+	if(is_lz4_image((void *) flash_address))
+		return copy_lz4_image_from_flash_to_ram(flash_address, ram_address);
+#endif
+
+	length = get_image_length_in_flash(flash_address);
 	if(!length)
-		return;
+		return 0;
+
+	/* Flash is only read once: the CRC is computed on the fly from the chunks copied to RAM. */
+	crc = MMPTR(flash_address + 4);
+	got_crc = 0;
+	printf("Copying 0x%08x to 0x%08lx (%d bytes)...\n", flash_address, ram_address, length);
+	offset = 0;
+	init_progression_bar(length);
+	/* 32KB chunks, the next chunk is copied (DMA when available) during the CRC of the current one. */
+	chunk_length = min(length, 0x8000);
+	dma_copy_start((void *) ram_address, (void *) flash_address + 8, chunk_length);
+	while (length > 0) {
+		dma_wait();
+		next_length = min(length - chunk_length, 0x8000);
+		if (next_length)
+			dma_copy_start((void *) ram_address + offset + chunk_length, (void*) flash_address + offset + chunk_length + 8, next_length);
+		got_crc = crc32_update(got_crc, (unsigned char *) ram_address + offset, chunk_length);
+		offset += chunk_length;
+		length -= chunk_length;
+		chunk_length = next_length;
+		show_progress(offset);
+	}
+	show_progress(offset);
+	printf("\n");
+
+	if(crc != got_crc) {
+		printf("CRC failed (expected %08x, got %08x)\n", crc, got_crc);
+		return 0;
+	}
+
+	return 1;
+}
+#endif
+
+void flashboot(void)
+{
+	printf("Booting from flash...\n");
 
 #ifdef MAIN_RAM_BASE
 	/* When Main RAM is available, copy the code from the Flash and execute it
 	from Main RAM since faster */
-	result = copy_image_from_flash_to_ram(FLASH_BOOT_ADDRESS, MAIN_RAM_BASE);
-	if(!result)
+	if(!copy_image_from_flash_to_ram(FLASH_BOOT_ADDRESS, MAIN_RAM_BASE))
 		return;
 	boot(0, 0, 0, MAIN_RAM_BASE);
 #else
 	/* When Main RAM is not available, execute the code directly from Flash (XIP).
        The code starts after (a) length and (b) CRC -- both uint32_t */
+	if(!check_image_in_flash(FLASH_BOOT_ADDRESS))
+		return;
 	boot(0, 0, 0, (FLASH_BOOT_ADDRESS + 2 * sizeof(uint32_t)));
 #endif
 }
@@ -674,6 +1417,7 @@ static int copy_file_from_sdcard_to_ram(const char * filename, unsigned long ram
 	uint32_t br;
 	uint32_t offset;
 	unsigned long length;
+	struct boot_image img;
 
 	fr = f_mount(&fs, "", 1);
 	if (fr != FR_OK)
@@ -688,9 +1432,10 @@ static int copy_file_from_sdcard_to_ram(const char * filename, unsigned long ram
 	length = f_size(&file);
 	printf("Copying %s to 0x%08lx (%ld bytes)...\n", filename, ram_address, length);
 	init_progression_bar(length);
+	boot_image_init(&img, ram_address);
 	offset = 0;
 	for (;;) {
-		fr = f_read(&file, (void*) ram_address + offset,  0x8000, (UINT *)&br);
+		fr = f_read(&file, img.load,  0x8000, (UINT *)&br);
 		if (fr != FR_OK) {
 			printf("file read error.\n");
 			f_close(&file);
@@ -699,6 +1444,11 @@ static int copy_file_from_sdcard_to_ram(const char * filename, unsigned long ram
 		}
 		if (br == 0)
 			break;
+		if (!boot_image_update(&img, br)) {
+			f_close(&file);
+			f_mount(0, "", 0);
+			return 0;
+		}
 		offset += br;
 		show_progress(offset);
 	}
@@ -708,7 +1458,7 @@ static int copy_file_from_sdcard_to_ram(const char * filename, unsigned long ram
 	f_close(&file);
 	f_mount(0, "", 0);
 
-	return 1;
+	return boot_image_end(&img) != 0;
 }
 
 static void sdcardboot_from_json(const char * filename)
@@ -855,6 +1605,7 @@ static int copy_file_from_sata_to_ram(const char * filename, unsigned long ram_a
 	uint32_t br;
 	uint32_t offset;
 	unsigned long length;
+	struct boot_image img;
 
 	fr = f_mount(&fs, "", 1);
 	if (fr != FR_OK)
@@ -869,9 +1620,10 @@ static int copy_file_from_sata_to_ram(const char * filename, unsigned long ram_a
 	length = f_size(&file);
 	printf("Copying %s to 0x%08lx (%ld bytes)...\n", filename, ram_address, length);
 	init_progression_bar(length);
+	boot_image_init(&img, ram_address);
 	offset = 0;
 	for (;;) {
-		fr = f_read(&file, (void*) ram_address + offset,  0x8000, (UINT *) &br);
+		fr = f_read(&file, img.load,  0x8000, (UINT *) &br);
 		if (fr != FR_OK) {
 			printf("file read error.\n");
 			f_close(&file);
@@ -880,6 +1632,11 @@ static int copy_file_from_sata_to_ram(const char * filename, unsigned long ram_a
 		}
 		if (br == 0)
 			break;
+		if (!boot_image_update(&img, br)) {
+			f_close(&file);
+			f_mount(0, "", 0);
+			return 0;
+		}
 		offset += br;
 		show_progress(offset);
 	}
@@ -889,7 +1646,7 @@ static int copy_file_from_sata_to_ram(const char * filename, unsigned long ram_a
 	f_close(&file);
 	f_mount(0, "", 0);
 
-	return 1;
+	return boot_image_end(&img) != 0;
 }
 
 static void sataboot_from_json(const char * filename)
@@ -8,6 +8,8 @@ void set_mac_addr(const char * mac_address);
 void __attribute__((noreturn)) boot(unsigned long r1, unsigned long r2, unsigned long r3, unsigned long addr);
 int serialboot(void);
 void netboot(int nb_params, char **params);
+void netload(int nb_params, char **params);
+unsigned int eth_udp_start(void);
 void flashboot(void);
 void romboot(void);
 void sdcardboot(void);
@@ -109,13 +109,23 @@ define_command(serialboot, serialboot, "Boot from Serial (SFL)", BOOT_CMDS);
 /**
  * Command "netboot"
  *
- * Boot software from TFTP server
+ * Boot software from TFTP server (or from multicast stream with "netboot mcast")
  *
  */
 #ifdef CSR_ETHMAC_BASE
 define_command(netboot, netboot, "Boot via Ethernet (TFTP)", BOOT_CMDS);
 #endif
 
+/**
+ * Command "netload"
+ *
+ * Load software from UDP bulk writes (litex_netload)
+ *
+ */
+#ifdef CSR_ETHMAC_BASE
+define_command(netload, netload, "Load/Boot via Ethernet (UDP bulk writes)", BOOT_CMDS);
+#endif
+
 /**
  * Command "spisdcardboot"
  *
@@ -30,15 +30,21 @@ define_command(sdram_init, sdram_init, "Initialize SDRAM (Init + Calibration)",
 /**
  * Command "sdram_cal"
  *
- * Calibrate SDRAM
+ * Calibrate SDRAM (full: exhaustive delay scans, for debugging)
  *
  */
 #if defined(CSR_SDRAM_BASE) && defined(CSR_DDRPHY_BASE)
 static void sdram_cal_handler(int nb_params, char **params)
 {
+	if (nb_params > 0 && strcmp(params[0], "full") != 0) {
+		printf("sdram_cal [full]");
+		return;
+	}
+	sdram_leveling_set_full_scan(nb_params > 0);
 	sdram_software_control_on();
 	sdram_leveling();
 	sdram_software_control_off();
+	sdram_leveling_set_full_scan(0);
 }
 define_command(sdram_cal, sdram_cal_handler, "Calibrate SDRAM", LITEDRAM_CMDS);
 #endif
@@ -88,6 +94,30 @@ static void sdram_bist_handler(int nb_params, char **params)
 define_command(sdram_bist, sdram_bist_handler, "Run SDRAM Build-In Self-Test", LITEDRAM_CMDS);
 #endif
 
+/**
+ * Command "sdram_bist_test"
+ *
+ * Test SDRAM (full size) with the Build-In Self-Test generator/checker
+ *
+ */
+#if defined(CSR_SDRAM_GENERATOR_BASE) && defined(CSR_SDRAM_CHECKER_BASE)
+static void sdram_bist_test_handler(int nb_params, char **params)
+{
+	char *c;
+	unsigned long size = MAIN_RAM_SIZE;
+
+	if (nb_params > 0) {
+		size = strtoul(params[0], &c, 0);
+		if (*c != 0) {
+			printf("Incorrect size");
+			return;
+		}
+	}
+	sdram_bist_memtest(0, size);
+}
+define_command(sdram_bist_test, sdram_bist_test_handler, "Test SDRAM with the Build-In Self-Test", LITEDRAM_CMDS);
+#endif
+
 #ifdef CSR_DDRPHY_RDPHASE_ADDR
 /**
  * Command "sdram_force_rdphase"
@@ -2,11 +2,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <generated/csr.h>
 #include <generated/soc.h>
 
 #include <libliteeth/mdio.h>
+#include <libliteeth/bench.h>
 
 #include "../command.h"
 #include "../helpers.h"
@@ -193,3 +195,53 @@ static void eth_mac_addr_handler(int nb_params, char **params)
 }
 define_command(eth_mac_addr, eth_mac_addr_handler, "Set the mac address", LITEETH_CMDS);
 #endif
+
+/**
+ * Command "eth_bench"
+ *
+ * Ethernet (UDP) throughput/latency benchmark against the remote ip
+ *
+ */
+#if defined(CSR_ETHMAC_BASE) && defined(CSR_TIMER0_BASE)
+static void eth_bench_handler(int nb_params, char **params)
+{
+	char *c;
+	unsigned int ip;
+	unsigned int port;
+	unsigned int args[3] = {0, 0, 0};
+	int i;
+
+	if (nb_params < 2) {
+		printf("eth_bench tx <port> [size] [rate_mbps] [seconds]\n");
+		printf("eth_bench rx <port> [seconds]\n");
+		printf("eth_bench echo <port> [size] [count]");
+		return;
+	}
+
+	port = strtoul(params[1], &c, 0);
+	if (*c != 0) {
+		printf("Incorrect port");
+		return;
+	}
+	/* Mode specific parameters. */
+	for (i = 0; (i < 3) && (i + 2 < nb_params); i++) {
+		args[i] = strtoul(params[i + 2], &c, 0);
+		if (*c != 0) {
+			printf("Incorrect parameter");
+			return;
+		}
+	}
+
+	ip = eth_udp_start();
+	if (strcmp(params[0], "tx") == 0)
+		eth_bench_tx(ip, port, args[0] ? args[0] : 1024, args[1], args[2]);
+	else if (strcmp(params[0], "rx") == 0)
+		eth_bench_rx(port, args[0]);
+	else if (strcmp(params[0], "echo") == 0)
+		eth_bench_echo(ip, port, args[0] ? args[0] : 1024, args[1] ? args[1] : 1000);
+	else
+		printf("Incorrect mode (tx, rx or echo)");
+}
+
+define_command(eth_bench, eth_bench_handler, "Run Ethernet benchmark (tx, rx, echo)", LITEETH_CMDS);
+#endif
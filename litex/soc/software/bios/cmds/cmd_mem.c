@@ -172,8 +172,10 @@ static void mem_copy_handler(int nb_params, char **params)
 		}
 	}
 
+	/* Explicit 32-bit word accesses (CSR/MMIO regions), volatile so that the loop is not turned
+	   into a memcpy call. */
 	for (i = 0; i < count; i++)
-		*dstaddr++ = *srcaddr++;
+		*(volatile unsigned int *)dstaddr++ = *(volatile unsigned int *)srcaddr++;
 }
 
 define_command(mem_copy, mem_copy_handler, "Copy address space", MEM_CMDS);
@@ -189,9 +191,11 @@ static void mem_test_handler(int nb_params, char **params)
 	char *c;
 	unsigned int *addr;
 	unsigned long maxsize = ~0uL;
+	int algo, width, errors;
 
 	if (nb_params < 1) {
-		printf("mem_test <addr> [<maxsize>]");
+		printf("mem_test <addr> [<maxsize>] [<algo>] [<width>]\n");
+		printf("algo: march_c, march_ss, checkerboard (default: bus/addr/data)");
 		return;
 	}
 
@@ -210,7 +214,34 @@ static void mem_test_handler(int nb_params, char **params)
 
 	}
 
-	memtest(addr, maxsize);
+	if (nb_params < 3) {
+		memtest(addr, maxsize);
+		return;
+	}
+
+	algo = memtest_algo_from_name(params[2]);
+	if (algo < 0) {
+		printf("Incorrect algo");
+		return;
+	}
+
+	width = sizeof(unsigned long);
+	if (nb_params >= 4) {
+		width = strtoul(params[3], &c, 0);
+		if ((*c != 0) || ((unsigned int) width > sizeof(unsigned long)) || (width & (width - 1)) || (width == 0)) {
+			printf("Incorrect width");
+			return;
+		}
+	}
+
+	printf("Memtest %s at %p (%lu bytes, %d-bit)...\n", memtest_algo_name(algo), addr, maxsize, 8*width);
+	errors = memtest_march(addr, maxsize, algo, width, NULL);
+	if (errors != 0) {
+		printf("  errors: %d\n", errors);
+		printf("Memtest KO\n");
+		return;
+	}
+	printf("Memtest OK\n");
 }
 define_command(mem_test, mem_test_handler, "Test memory access", MEM_CMDS);
 
@@ -265,6 +296,39 @@ static void mem_speed_handler(int nb_params, char **params)
 }
 define_command(mem_speed, mem_speed_handler, "Test memory speed", MEM_CMDS);
 
+/**
+ * Command "mem_bench"
+ *
+ * Memory Benchmark (latency/stride/bandwidth)
+ *
+ */
+static void mem_bench_handler(int nb_params, char **params)
+{
+	char *c;
+	unsigned int *addr;
+	unsigned long size;
+
+	if (nb_params < 2) {
+		printf("mem_bench <addr> <size>");
+		return;
+	}
+
+	addr = (unsigned int *)strtoul(params[0], &c, 0);
+	if (*c != 0) {
+		printf("Incorrect address");
+		return;
+	}
+
+	size = strtoul(params[1], &c, 0);
+	if (*c != 0) {
+		printf("Incorrect size");
+		return;
+	}
+
+	membench(addr, size);
+}
+define_command(mem_bench, mem_bench_handler, "Benchmark memory latency/bandwidth", MEM_CMDS);
+
 /**
  * Command "mem_cmp"
  *
@@ -8,6 +8,11 @@
 #define SFL_MAGIC_REQ "sL5DdSMmkekro\n"
 #define SFL_MAGIC_ACK "z6IHG7cYDID6o\n"
 
+/* SFL v2 is advertised by sending SFL_MAGIC_REQ_V2 before SFL_MAGIC_REQ, a v2 capable host
+ * answers with SFL_MAGIC_ACK_V2 followed by a flags byte, other hosts use SFL v1. */
+#define SFL_MAGIC_REQ_V2 "sL5DdSMmkekr2\n"
+#define SFL_MAGIC_ACK_V2 "z6IHG7cYDID62\n"
+
 struct sfl_frame {
 	unsigned char payload_length;
 	unsigned char crc[2];
@@ -15,10 +20,29 @@ struct sfl_frame {
 	unsigned char payload[255];
 } __attribute__((packed));
 
+/* SFL v2 frames are sent in a sliding window of up to SFL_V2_WINDOW frames: the device acknowledges
+ * each frame with the reply code followed by the next expected sequence number (cumulative ACK) and
+ * keeps the frames received out of order, so the host only has to retransmit the missing ones. The
+ * CRC (CRC16 or CRC32 with SFL_V2_FLAG_CRC32) covers seq, cmd, payload_length and payload. */
+#define SFL_V2_FLAG_CRC32	0x01
+
+#define SFL_V2_WINDOW		32
+#define SFL_V2_PAYLOAD_MAX	1024
+#define SFL_V2_HEADER_LEN	8
+
+struct sfl_frame_v2 {
+	unsigned char crc[4];
+	unsigned char seq;
+	unsigned char cmd;
+	unsigned char payload_length[2];
+	unsigned char payload[SFL_V2_PAYLOAD_MAX];
+} __attribute__((packed));
+
 /* General commands */
 #define SFL_CMD_ABORT		0x00
 #define SFL_CMD_LOAD		0x01
 #define SFL_CMD_JUMP		0x02
+#define SFL_CMD_LZ4		0x03 /* Decompress LZ4 image in place (BIOS_LZ4) */
 
 /* Replies */
 #define SFL_ACK_SUCCESS		'K'
@@ -8,6 +8,13 @@ extern "C" {
 unsigned short crc16(const unsigned char *buffer, int len);
 unsigned int crc32(const unsigned char *buffer, unsigned int len);
 
+/* Incremental CRC32: crc32(buf, len) == crc32_update(0, buf, len). */
+unsigned int crc32_update(unsigned int crc, const unsigned char *buffer, unsigned int len);
+
+/* Optional CRC32 engine (ex: hardware accelerator) with crc32_update() semantics. */
+typedef unsigned int (*crc32_engine_t)(unsigned int crc, const unsigned char *buffer, unsigned int len);
+void crc32_set_engine(crc32_engine_t engine);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,157 @@
+#include "dma.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <system.h>
+
+#include <generated/csr.h>
+#include <generated/soc.h>
+
+#ifdef CSR_DMA_BASE
+
+/* DMA transfers are done in bus words. */
+#define DMA_ALIGN   (CONFIG_BUS_DATA_WIDTH/8)
+#define DMA_MASK    (DMA_ALIGN - 1)
+
+/* Smaller transfers are done by the CPU. */
+#ifndef DMA_MIN_LEN
+#define DMA_MIN_LEN 256
+#endif
+
+static int dma_busy;
+
+/* Unaligned head/tail of the transfer in flight, done by the CPU once the DMA is done (they can
+   share cache lines with the DMA destination). */
+static struct {
+	unsigned char *dst;
+	const unsigned char *src;
+	unsigned long len;
+	unsigned long head;
+	unsigned long tail;
+	int fill;
+	int c;
+} dma_pending;
+
+static void dma_start(uintptr_t dst, uintptr_t src, unsigned long len, int fill, uint32_t value)
+{
+	dma_wait();
+
+	/* Write-back CPUs: make the source/destination data visible to the DMA */
+	flush_cpu_dcache();
+
+	dma_writer_enable_write(0);
+	dma_reader_enable_write(0);
+	dma_fill_write(fill);
+	dma_fill_value_write(value);
+	dma_writer_base_write(dst);
+	dma_writer_length_write(len);
+	dma_writer_enable_write(1);
+	if (!fill) {
+		dma_reader_base_write(src);
+		dma_reader_length_write(len);
+		dma_reader_enable_write(1);
+	}
+	dma_busy = 1;
+}
+
+int dma_done(void)
+{
+	if (!dma_busy)
+		return 1;
+	if (dma_writer_done_read() == 0)
+		return 0;
+	dma_writer_enable_write(0);
+	dma_reader_enable_write(0);
+	/* Drop the stale destination data from the CPU cache */
+	flush_cpu_dcache();
+	dma_busy = 0;
+	/* Head/tail with the CPU */
+	if (dma_pending.fill) {
+		memset(dma_pending.dst, dma_pending.c, dma_pending.head);
+		memset(dma_pending.dst + dma_pending.len - dma_pending.tail, dma_pending.c, dma_pending.tail);
+	} else {
+		memcpy(dma_pending.dst, dma_pending.src, dma_pending.head);
+		memcpy(dma_pending.dst + dma_pending.len - dma_pending.tail,
+		       dma_pending.src + dma_pending.len - dma_pending.tail, dma_pending.tail);
+	}
+	return 1;
+}
+
+void dma_copy_start(void *dst, const void *src, unsigned long len)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	unsigned long head, tail;
+
+	if ((len < DMA_MIN_LEN) || (((uintptr_t) d ^ (uintptr_t) s) & DMA_MASK)) {
+		dma_wait();
+		memcpy(dst, src, len);
+		return;
+	}
+	head = (DMA_ALIGN - ((uintptr_t) d & DMA_MASK)) & DMA_MASK;
+	tail = (len - head) & DMA_MASK;
+	dma_start((uintptr_t) (d + head), (uintptr_t) (s + head), len - head - tail, 0, 0);
+	dma_pending.dst  = d;
+	dma_pending.src  = s;
+	dma_pending.len  = len;
+	dma_pending.head = head;
+	dma_pending.tail = tail;
+	dma_pending.fill = 0;
+}
+
+void dma_fill_start(void *dst, int c, unsigned long len)
+{
+	unsigned char *d = dst;
+	unsigned long head, tail;
+
+	if (len < DMA_MIN_LEN) {
+		dma_wait();
+		memset(dst, c, len);
+		return;
+	}
+	head = (DMA_ALIGN - ((uintptr_t) d & DMA_MASK)) & DMA_MASK;
+	tail = (len - head) & DMA_MASK;
+	dma_start((uintptr_t) (d + head), 0, len - head - tail, 1, 0x01010101*(unsigned char) c);
+	dma_pending.dst  = d;
+	dma_pending.len  = len;
+	dma_pending.head = head;
+	dma_pending.tail = tail;
+	dma_pending.fill = 1;
+	dma_pending.c    = c;
+}
+
+#else
+
+int dma_done(void)
+{
+	return 1;
+}
+
+void dma_copy_start(void *dst, const void *src, unsigned long len)
+{
+	memcpy(dst, src, len);
+}
+
+void dma_fill_start(void *dst, int c, unsigned long len)
+{
+	memset(dst, c, len);
+}
+
+#endif
+
+void dma_wait(void)
+{
+	while (!dma_done());
+}
+
+void dma_copy(void *dst, const void *src, unsigned long len)
+{
+	dma_copy_start(dst, src, len);
+	dma_wait();
+}
+
+void dma_fill(void *dst, int c, unsigned long len)
+{
+	dma_fill_start(dst, c, len);
+	dma_wait();
+}
@@ -0,0 +1,30 @@
+#ifndef __DMA_H
+#define __DMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Memory to memory copy/fill.
+ * Uses the DMA (SoC.add_dma, dma_* CSRs) when present, the CPU (memcpy/memset) otherwise or when
+ * the transfer can't be done by the DMA (too small, source/destination alignments differ); the
+ * unaligned head/tail are done by the CPU once the DMA is done (after the CPU data cache
+ * invalidation), so the destination is only complete when dma_done() returns 1. Only one transfer
+ * can be in flight: starting a new one waits for the previous one.
+ */
+void dma_copy_start(void *dst, const void *src, unsigned long len);
+void dma_fill_start(void *dst, int c, unsigned long len);
+
+/* Returns 1 when the current transfer is done (or no transfer in flight), 0 otherwise. */
+int dma_done(void);
+void dma_wait(void);
+
+/* Start + wait. */
+void dma_copy(void *dst, const void *src, unsigned long len);
+void dma_fill(void *dst, int c, unsigned long len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DMA_H */
@@ -0,0 +1,107 @@
+#include "lz4.h"
+
+#include <string.h>
+
+/*
+ * LZ4 block format: a sequence of (token, literals, match) until the end of the block:
+ * - token: literal length (4 MSBs) and match length - 4 (4 LSBs), 15 = extended with
+ *   additional bytes (added until a byte != 255).
+ * - literals.
+ * - match: little-endian 16-bit offset (back in the output) and optional extended length.
+ * The last sequence only has literals.
+ */
+
+enum {
+	LZ4_TOKEN,
+	LZ4_LITERAL_LENGTH,
+	LZ4_LITERALS,
+	LZ4_OFFSET_LOW,
+	LZ4_OFFSET_HIGH,
+	LZ4_MATCH_LENGTH,
+};
+
+void lz4_stream_init(struct lz4_stream *s, void *dst, unsigned int dst_len)
+{
+	s->dst       = dst;
+	s->dst_start = dst;
+	s->dst_end   = s->dst + dst_len;
+	s->length    = 0;
+	s->offset    = 0;
+	s->token     = 0;
+	s->state     = LZ4_TOKEN;
+}
+
+static int lz4_copy_match(struct lz4_stream *s)
+{
+	unsigned char *ref;
+	unsigned int n;
+
+	n = s->length + 4;
+	if((s->offset == 0) ||
+	   (s->offset > (unsigned int)(s->dst - s->dst_start)) ||
+	   (n > (unsigned int)(s->dst_end - s->dst)))
+		return -1;
+	/* Byte copy: the match can overlap the output. */
+	ref = s->dst - s->offset;
+	while(n--)
+		*s->dst++ = *ref++;
+	s->state = LZ4_TOKEN;
+	return 0;
+}
+
+int lz4_stream_decompress(struct lz4_stream *s, const void *src, unsigned int len)
+{
+	const unsigned char *ip = src;
+	const unsigned char *iend = ip + len;
+	unsigned int n;
+	unsigned char c;
+
+	while(ip < iend) {
+		switch(s->state) {
+			case LZ4_TOKEN:
+				s->token  = *ip++;
+				s->length = s->token >> 4;
+				s->state  = (s->length == 15) ? LZ4_LITERAL_LENGTH : LZ4_LITERALS;
+				break;
+			case LZ4_LITERAL_LENGTH:
+				c = *ip++;
+				s->length += c;
+				if(c != 255)
+					s->state = LZ4_LITERALS;
+				break;
+			case LZ4_LITERALS:
+				n = iend - ip;
+				if(n > s->length)
+					n = s->length;
+				if(n > (unsigned int)(s->dst_end - s->dst))
+					return -1;
+				/* memmove: input and output can overlap when decompressing in place. */
+				memmove(s->dst, ip, n);
+				s->dst    += n;
+				ip        += n;
+				s->length -= n;
+				if(s->length == 0)
+					s->state = LZ4_OFFSET_LOW;
+				break;
+			case LZ4_OFFSET_LOW:
+				s->offset = *ip++;
+				s->state  = LZ4_OFFSET_HIGH;
+				break;
+			case LZ4_OFFSET_HIGH:
+				s->offset |= (*ip++) << 8;
+				s->length  = s->token & 0xf;
+				if(s->length == 15)
+					s->state = LZ4_MATCH_LENGTH;
+				else if(lz4_copy_match(s) < 0)
+					return -1;
+				break;
+			case LZ4_MATCH_LENGTH:
+				c = *ip++;
+				s->length += c;
+				if((c != 255) && (lz4_copy_match(s) < 0))
+					return -1;
+				break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef __LZ4_H
+#define __LZ4_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Streaming LZ4 block decompressor.
+ * The compressed data can be provided in chunks of any size; the output is written
+ * contiguously to memory and the previous output is used as the match dictionary, so no
+ * window buffer is needed. Decompression in place is supported when the compressed data is
+ * located at the end of the output buffer (with a margin).
+ */
+struct lz4_stream {
+	unsigned char *dst;
+	unsigned char *dst_start;
+	unsigned char *dst_end;
+	unsigned int length;
+	unsigned int offset;
+	unsigned char token;
+	unsigned char state;
+};
+
+void lz4_stream_init(struct lz4_stream *s, void *dst, unsigned int dst_len);
+
+/* Returns 0 on success, -1 on corrupted data or output buffer overflow. */
+int lz4_stream_decompress(struct lz4_stream *s, const void *src, unsigned int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LZ4_H */
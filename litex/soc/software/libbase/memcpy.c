@@ -0,0 +1,173 @@
+#include <string.h>
+#include <stdint.h>
+
+#include <generated/soc.h>
+
+/*
+ * memcpy/memset replacing the picolibc ones (built for size, so byte loops on most CPUs); the
+ * picolibc symbols are made weak when building libc (see libc/Makefile).
+ *
+ * The destination is first aligned, then data is moved by blocks of MEM_BLOCK_WORDS words (at
+ * least the bus data width) with grouped word loads followed by word stores, so consecutive bus
+ * beats are issued. A source not aligned with the destination is read with aligned words that
+ * are shifted/merged (no misaligned accesses, not supported by all CPUs).
+ *
+ * Note: the loops must not be converted back to memcpy/memset calls by the compiler, this file
+ * is built with -fno-tree-loop-distribute-patterns (see libbase/Makefile).
+ */
+
+typedef unsigned long __attribute__((__may_alias__)) mem_word_t;
+
+#define MEM_WSIZE sizeof(mem_word_t)
+#define MEM_WMASK (MEM_WSIZE - 1)
+
+#ifndef CONFIG_BUS_DATA_WIDTH
+#define CONFIG_BUS_DATA_WIDTH 32
+#endif
+
+#define MEM_BLOCK_WORDS ((CONFIG_BUS_DATA_WIDTH/8 > 4*MEM_WSIZE) ? CONFIG_BUS_DATA_WIDTH/8/MEM_WSIZE : 4)
+#define MEM_BLOCK_SIZE  (MEM_BLOCK_WORDS*MEM_WSIZE)
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define MEM_MERGE(_a, _b, _shift) (((_a) << (_shift)) | ((_b) >> (8*MEM_WSIZE - (_shift))))
+#else
+#define MEM_MERGE(_a, _b, _shift) (((_a) >> (_shift)) | ((_b) << (8*MEM_WSIZE - (_shift))))
+#endif
+
+void *memcpy(void *dst, const void *src, size_t n)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	mem_word_t *dw;
+	const mem_word_t *sw;
+	mem_word_t w0, w1, w2, w3, w4;
+	unsigned int i, shift;
+
+	/* Small copies */
+	if (n < 2*MEM_WSIZE) {
+		while (n--)
+			*d++ = *s++;
+		return dst;
+	}
+
+	/* Align destination */
+	while ((uintptr_t) d & MEM_WMASK) {
+		*d++ = *s++;
+		n--;
+	}
+	dw = (mem_word_t *) d;
+
+	if (((uintptr_t) s & MEM_WMASK) == 0) {
+		/* Aligned source: blocks of words */
+		sw = (const mem_word_t *) s;
+		while (n >= MEM_BLOCK_SIZE) {
+			for (i = 0; i < MEM_BLOCK_WORDS; i += 4) {
+				w0 = sw[i + 0];
+				w1 = sw[i + 1];
+				w2 = sw[i + 2];
+				w3 = sw[i + 3];
+				dw[i + 0] = w0;
+				dw[i + 1] = w1;
+				dw[i + 2] = w2;
+				dw[i + 3] = w3;
+			}
+			dw += MEM_BLOCK_WORDS;
+			sw += MEM_BLOCK_WORDS;
+			n  -= MEM_BLOCK_SIZE;
+		}
+		while (n >= MEM_WSIZE) {
+			*dw++ = *sw++;
+			n -= MEM_WSIZE;
+		}
+	} else {
+		/* Unaligned source: aligned reads, merged. The last aligned word read contains data to
+		   copy, so reads never go beyond the source buffer's last word. */
+		shift = 8*((uintptr_t) s & MEM_WMASK);
+		sw    = (const mem_word_t *) ((uintptr_t) s & ~(uintptr_t) MEM_WMASK);
+		w0    = *sw++;
+		while (n >= 4*MEM_WSIZE) {
+			w1 = sw[0];
+			w2 = sw[1];
+			w3 = sw[2];
+			w4 = sw[3];
+			dw[0] = MEM_MERGE(w0, w1, shift);
+			dw[1] = MEM_MERGE(w1, w2, shift);
+			dw[2] = MEM_MERGE(w2, w3, shift);
+			dw[3] = MEM_MERGE(w3, w4, shift);
+			w0  = w4;
+			dw += 4;
+			sw += 4;
+			n  -= 4*MEM_WSIZE;
+		}
+		while (n >= MEM_WSIZE) {
+			w1 = *sw++;
+			*dw++ = MEM_MERGE(w0, w1, shift);
+			w0 = w1;
+			n -= MEM_WSIZE;
+		}
+		/* Back to the unaligned source position */
+		s = (const unsigned char *) sw - MEM_WSIZE + shift/8;
+		d = (unsigned char *) dw;
+		while (n--)
+			*d++ = *s++;
+		return dst;
+	}
+
+	/* Tail */
+	d = (unsigned char *) dw;
+	s = (const unsigned char *) sw;
+	while (n--)
+		*d++ = *s++;
+
+	return dst;
+}
+
+void *memset(void *dst, int c, size_t n)
+{
+	unsigned char *d = dst;
+	mem_word_t *dw;
+	mem_word_t w;
+	unsigned int i;
+
+	/* Small fills */
+	if (n < 2*MEM_WSIZE) {
+		while (n--)
+			*d++ = c;
+		return dst;
+	}
+
+	/* Align destination */
+	while ((uintptr_t) d & MEM_WMASK) {
+		*d++ = c;
+		n--;
+	}
+	dw = (mem_word_t *) d;
+
+	/* Blocks of words */
+	w = (unsigned char) c;
+	w |= w << 8;
+	w |= w << 16;
+	if (MEM_WSIZE > 4)
+		w |= (w << 16) << 16;
+	while (n >= MEM_BLOCK_SIZE) {
+		for (i = 0; i < MEM_BLOCK_WORDS; i += 4) {
+			dw[i + 0] = w;
+			dw[i + 1] = w;
+			dw[i + 2] = w;
+			dw[i + 3] = w;
+		}
+		dw += MEM_BLOCK_WORDS;
+		n  -= MEM_BLOCK_SIZE;
+	}
+	while (n >= MEM_WSIZE) {
+		*dw++ = w;
+		n -= MEM_WSIZE;
+	}
+
+	/* Tail */
+	d = (unsigned char *) dw;
+	while (n--)
+		*d++ = c;
+
+	return dst;
+}
@@ -2,6 +2,8 @@
 #include "lfsr.h"
 
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <system.h>
 
 #include <generated/soc.h>
@@ -188,29 +190,116 @@ static void print_progress(const char * header, unsigned int offset, unsigned in
 	printf("   \r");
 }
 
+/* Data test: the 32-bit words sequence (seed_to_data_32) is accessed with native (unsigned long)
+   words on the aligned part of the region (32-bit words on the unaligned head/tail). The aligned
+   part is done per MEMTEST_DATA_CHUNK (progress) with inner loops unrolled by MEMTEST_DATA_UNROLL
+   native words, the read loop does a single comparison per group of words and only checks the
+   32-bit words of a group on a mismatch. The sequence is a single chained LFSR (one step per
+   32-bit word) to keep the patterns of the original test. */
+
+#define MEMTEST_DATA_CHUNK  (1*MIB)
+#define MEMTEST_DATA_WORDS  (sizeof(unsigned long)/4) /* 32-bit words per native word. */
+#define MEMTEST_DATA_UNROLL 4                         /* Native words per inner loop iteration. */
+#define MEMTEST_DATA_GROUP  (MEMTEST_DATA_UNROLL*MEMTEST_DATA_WORDS)
+
+typedef union {
+	unsigned long l;
+	unsigned int  w[MEMTEST_DATA_WORDS];
+} memtest_data_word;
+
+static inline unsigned long memtest_data_next(unsigned int *seed_32, int random)
+{
+	memtest_data_word d;
+	unsigned long k;
+
+	for (k = 0; k < MEMTEST_DATA_WORDS; k++) {
+		*seed_32 = seed_to_data_32(*seed_32, random);
+		d.w[k] = *seed_32;
+	}
+	return d.l;
+}
+
+/* Check a 32-bit word (first read: rdata) with retries/callback/debug, returns -1 when the
+   callback asks to stop. */
+static int memtest_data_check(volatile unsigned int *addr, unsigned int rdata, unsigned int expected, struct memtest_config *config, int *errors)
+{
+	int j, ok_at;
+
+	ok_at = -1;
+	for (j = 0; j < MEMTEST_DATA_RETRIES + 1; ++j) {
+		if (j > 0)
+			rdata = *addr;
+		if (rdata == expected) {
+			ok_at = j;
+			break;
+		}
+	}
+	if (ok_at > 0)
+		printf("@%p: Redeemed at %d. attempt\n", addr, ok_at + 1);
+
+	if(rdata != expected) {
+		(*errors)++;
+		if (config != NULL && config->on_error != NULL) {
+			// call the handler, if non-zero status is returned finish now
+			if (config->on_error((unsigned long) addr, rdata, expected, config->arg) != 0)
+				return -1;
+		}
+#ifdef MEMTEST_DATA_DEBUG
+		if (MEMTEST_DEBUG_MAX_ERRORS < 0 || *errors <= MEMTEST_DEBUG_MAX_ERRORS)
+			printf("memtest_data error @ %p: 0x%08x vs 0x%08x\n", addr, rdata, expected);
+#endif
+	}
+	return 0;
+}
+
 int memtest_data(unsigned int *addr, unsigned long size, int random, struct memtest_config *config)
 {
 	volatile unsigned int *array = addr;
-	int i, errors;
-	int j, ok_at;
-	int progress;
+	volatile unsigned long *p;
+	unsigned long words = size/4;
+	unsigned long chunk = MEMTEST_DATA_CHUNK/4;
+	unsigned long head, body, end;
+	unsigned long i, k;
 	unsigned int seed_32;
-	unsigned int rdata;
+	unsigned long d[MEMTEST_DATA_UNROLL], r[MEMTEST_DATA_UNROLL];
+	memtest_data_word dw, rw;
+	int errors;
+	int progress;
 
 	progress = config == NULL ? 1 : config->show_progress;
 	errors  = 0;
-	seed_32 = 1;
+
+	/* Unaligned head (32-bit words), aligned body (groups of native words), tail (32-bit words) */
+	for (head = 0; (head < words) && ((uintptr_t)&array[head] % sizeof(unsigned long)); head++);
+	body = head + (words - head)/MEMTEST_DATA_GROUP*MEMTEST_DATA_GROUP;
 
 	if (config == NULL || !config->read_only) {
 		/* Write datas */
-		for(i=0; i<size/4; i++) {
+		seed_32 = 1;
+		for (i = 0; i < head; i++) {
 			seed_32 = seed_to_data_32(seed_32, random);
 			array[i] = seed_32;
-			if (i%0x8000 == 0)
+		}
+		while (i < body) {
+			end = min(i + chunk, body);
+			for (; i < end; i += MEMTEST_DATA_GROUP) {
+				p = (volatile unsigned long *)&array[i];
+				p[0] = memtest_data_next(&seed_32, random);
+				p[1] = memtest_data_next(&seed_32, random);
+				p[2] = memtest_data_next(&seed_32, random);
+				p[3] = memtest_data_next(&seed_32, random);
+			}
+			if (progress)
 				print_progress("  Write:", (unsigned long)addr, 4*i);
 		}
-		print_progress("  Write:", (unsigned long)addr, 4*i);
-		printf("\n");
+		for (; i < words; i++) {
+			seed_32 = seed_to_data_32(seed_32, random);
+			array[i] = seed_32;
+		}
+		if (progress) {
+			print_progress("  Write:", (unsigned long)addr, 4*i);
+			printf("\n");
+		}
 	}
 
 	/* Flush caches */
@@ -219,35 +308,40 @@ int memtest_data(unsigned int *addr, unsigned long size, int random, struct memt
 
 	/* Read/Verify datas */
 	seed_32 = 1;
-	for(i=0; i<size/4; i++) {
+	for (i = 0; i < head; i++) {
 		seed_32 = seed_to_data_32(seed_32, random);
-
-		ok_at = -1;
-		for (j = 0; j < MEMTEST_DATA_RETRIES + 1; ++j) {
-			rdata = array[i];
-			if (rdata == seed_32) {
-				ok_at = j;
-				break;
-			}
-		}
-		if (ok_at > 0)
-			printf("@%p: Redeemed at %d. attempt\n", addr + i, ok_at + 1);
-
-		if(rdata != seed_32) {
-			errors++;
-			if (config != NULL && config->on_error != NULL) {
-				// call the handler, if non-zero status is returned finish now
-				if (config->on_error((unsigned long) (addr + i), rdata, seed_32, config->arg) != 0)
+		if (memtest_data_check(&array[i], array[i], seed_32, config, &errors) < 0)
+			return errors;
+	}
+	while (i < body) {
+		end = min(i + chunk, body);
+		for (; i < end; i += MEMTEST_DATA_GROUP) {
+			p = (volatile unsigned long *)&array[i];
+			d[0] = memtest_data_next(&seed_32, random);
+			d[1] = memtest_data_next(&seed_32, random);
+			d[2] = memtest_data_next(&seed_32, random);
+			d[3] = memtest_data_next(&seed_32, random);
+			r[0] = p[0];
+			r[1] = p[1];
+			r[2] = p[2];
+			r[3] = p[3];
+			if (((r[0] ^ d[0]) | (r[1] ^ d[1]) | (r[2] ^ d[2]) | (r[3] ^ d[3])) == 0)
+				continue;
+			for (k = 0; k < MEMTEST_DATA_GROUP; k++) {
+				rw.l = r[k/MEMTEST_DATA_WORDS];
+				dw.l = d[k/MEMTEST_DATA_WORDS];
+				if (memtest_data_check(&array[i + k], rw.w[k%MEMTEST_DATA_WORDS], dw.w[k%MEMTEST_DATA_WORDS], config, &errors) < 0)
 					return errors;
 			}
-#ifdef MEMTEST_DATA_DEBUG
-			if (MEMTEST_DEBUG_MAX_ERRORS < 0 || errors <= MEMTEST_DEBUG_MAX_ERRORS)
-				printf("memtest_data error @ %p: 0x%08x vs 0x%08x\n", addr + i, rdata, seed_32);
-#endif
 		}
-		if (i%0x8000 == 0 && progress)
+		if (progress)
 			print_progress("   Read:", (unsigned long)addr, 4*i);
 	}
+	for (; i < words; i++) {
+		seed_32 = seed_to_data_32(seed_32, random);
+		if (memtest_data_check(&array[i], array[i], seed_32, config, &errors) < 0)
+			return errors;
+	}
 	if (progress) {
 		print_progress("   Read:", (unsigned long)addr, 4*i);
 		printf("\n");
@@ -256,6 +350,281 @@ int memtest_data(unsigned int *addr, unsigned long size, int random, struct memt
 	return errors;
 }
 
+/* March/Checkerboard tests.
+ *
+ * Word-oriented tests with a configurable access width (1, 2, 4 or 8 bytes, up to the native
+ * width) to also cover the byte lanes/masks. The March elements keep the per-cell order of the
+ * operations (required to detect the coupling faults between neighbour cells) but are unrolled
+ * by 4 cells, with the comparisons deferred to a single test per group of cells; errors are then
+ * reported at 32-bit granularity as for memtest_data.
+ * These tests go through the caches (flushed between elements): use a region larger than the
+ * caches for the elements to reach the memory.
+ */
+
+//#define MEMTEST_MARCH_DEBUG
+
+enum {
+	MARCH_W,  /* w            (ascending)  */
+	MARCH_R,  /* r            (ascending)  */
+	MARCH_RW, /* r, w                      */
+	MARCH_SS, /* r, r, w(r), r, w          */
+};
+
+/* r/w: 0 for the background, 1 for its inverse. alt: invert odd cells (W/R only). */
+struct march_element {
+	unsigned char op;
+	unsigned char up;
+	unsigned char r;
+	unsigned char w;
+	unsigned char alt;
+};
+
+struct march_algo {
+	const char *name;
+	unsigned long long bg;
+	const struct march_element *elements;
+	int nelements;
+};
+
+/* March C-: {(w0); U(r0,w1); U(r1,w0); D(r0,w1); D(r1,w0); (r0)} */
+static const struct march_element march_c_minus[] = {
+	{MARCH_W,  1, 0, 0, 0},
+	{MARCH_RW, 1, 0, 1, 0},
+	{MARCH_RW, 1, 1, 0, 0},
+	{MARCH_RW, 0, 0, 1, 0},
+	{MARCH_RW, 0, 1, 0, 0},
+	{MARCH_R,  1, 0, 0, 0},
+};
+
+/* March SS: {(w0); U(r0,r0,w0,r0,w1); U(r1,r1,w1,r1,w0); D(r0,r0,w0,r0,w1); D(r1,r1,w1,r1,w0); (r0)} */
+static const struct march_element march_ss[] = {
+	{MARCH_W,  1, 0, 0, 0},
+	{MARCH_SS, 1, 0, 1, 0},
+	{MARCH_SS, 1, 1, 0, 0},
+	{MARCH_SS, 0, 0, 1, 0},
+	{MARCH_SS, 0, 1, 0, 0},
+	{MARCH_R,  1, 0, 0, 0},
+};
+
+/* Checkerboard: 0x55/0xaa bits in alternating cells, then inverted. */
+static const struct march_element march_checkerboard[] = {
+	{MARCH_W,  1, 0, 0, 1},
+	{MARCH_R,  1, 0, 0, 1},
+	{MARCH_W,  1, 0, 1, 1},
+	{MARCH_R,  1, 1, 0, 1},
+};
+
+#define MARCH_ALGO(_name, _bg, _elements) {_name, _bg, _elements, sizeof(_elements)/sizeof(_elements[0])}
+
+static const struct march_algo march_algos[MEMTEST_ALGOS] = {
+	[MEMTEST_MARCH_C]      = MARCH_ALGO("march_c",      0x0000000000000000ULL, march_c_minus),
+	[MEMTEST_MARCH_SS]     = MARCH_ALGO("march_ss",     0x0000000000000000ULL, march_ss),
+	[MEMTEST_CHECKERBOARD] = MARCH_ALGO("checkerboard", 0x5555555555555555ULL, march_checkerboard),
+};
+
+const char *memtest_algo_name(int algo)
+{
+	return march_algos[algo].name;
+}
+
+int memtest_algo_from_name(const char *name)
+{
+	int i;
+	for (i = 0; i < MEMTEST_ALGOS; i++)
+		if (strcmp(name, march_algos[i].name) == 0)
+			return i;
+	return -1;
+}
+
+/* Report a word error at 32-bit granularity, returns -1 when the callback asks to stop. */
+static int march_report(unsigned long addr, unsigned long rdata, unsigned long ref, int width, struct memtest_config *config, int *errors)
+{
+	union {
+		unsigned long l;
+		unsigned int w[sizeof(unsigned long)/4];
+	} r, e;
+	int i, n;
+
+	r.l = rdata;
+	e.l = ref;
+	n   = width/4;
+	if (width <= 4) {
+		r.w[0] = rdata;
+		e.w[0] = ref;
+		n      = 1;
+	}
+	for (i = 0; i < n; i++) {
+		if (r.w[i] == e.w[i])
+			continue;
+		(*errors)++;
+#ifdef MEMTEST_MARCH_DEBUG
+		if (MEMTEST_DEBUG_MAX_ERRORS < 0 || *errors <= MEMTEST_DEBUG_MAX_ERRORS)
+			printf("memtest_march error @ 0x%lx: 0x%08x vs 0x%08x\n", addr + 4*i, r.w[i], e.w[i]);
+#endif
+		if (config != NULL && config->on_error != NULL) {
+			// call the handler, if non-zero status is returned finish now
+			if (config->on_error(addr + 4*i, r.w[i], e.w[i], config->arg) != 0)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/* Elements for each access width (T = uint<b>_t), p is the first cell, s the direction. */
+#define MARCH_FUNCS(_b)                                                                               \
+static int march_check_##_b(volatile uint##_b##_t *p, long s, int count, const uint##_b##_t *x,      \
+	uint##_b##_t r0, uint##_b##_t r1, struct memtest_config *config, int *errors)                   \
+{                                                                                                     \
+	int j;                                                                                        \
+	for (j = 0; j < count; j++) {                                                                 \
+		uint##_b##_t r = (j & 1) ? r1 : r0;                                                   \
+		if ((x[j] != r) &&                                                                    \
+		    (march_report((unsigned long) &p[j*s], x[j], r, _b/8, config, errors) < 0))       \
+			return -1;                                                                    \
+	}                                                                                             \
+	return 0;                                                                                     \
+}                                                                                                     \
+                                                                                                      \
+static int march_element_##_b(volatile uint##_b##_t *a, unsigned long n, const struct march_element *e, \
+	uint##_b##_t bg, struct memtest_config *config, int *errors)                                    \
+{                                                                                                     \
+	const uint##_b##_t r0 = e->r ? ~bg : bg, r1 = e->alt ? ~r0 : r0;                              \
+	const uint##_b##_t w0 = e->w ? ~bg : bg, w1 = e->alt ? ~w0 : w0;                              \
+	volatile uint##_b##_t *p = a;                                                                 \
+	long s = 1;                                                                                   \
+	uint##_b##_t x[4], y[4], z[4];                                                                \
+	unsigned long k;                                                                              \
+	int c;                                                                                        \
+                                                                                                      \
+	if ((e->op == MARCH_RW || e->op == MARCH_SS) && !e->up) {                                     \
+		p = a + n - 1;                                                                        \
+		s = -1;                                                                               \
+	}                                                                                             \
+	for (k = 0; k < n; k += c, p += c*s) {                                                        \
+		c = (n - k < 4) ? n - k : 4;                                                          \
+		switch (e->op) {                                                                      \
+		case MARCH_W:                                                                         \
+			if (c == 4) {                                                                 \
+				p[0] = w0; p[1] = w1; p[2] = w0; p[3] = w1;                           \
+			} else {                                                                      \
+				for (c = 0; k + c < n; c++)                                           \
+					p[c] = (c & 1) ? w1 : w0;                                     \
+			}                                                                             \
+			break;                                                                        \
+		case MARCH_R:                                                                         \
+			if (c == 4) {                                                                 \
+				x[0] = p[0]; x[1] = p[1]; x[2] = p[2]; x[3] = p[3];                   \
+				if (((x[0] ^ r0) | (x[1] ^ r1) | (x[2] ^ r0) | (x[3] ^ r1)) == 0)     \
+					break;                                                        \
+			} else {                                                                      \
+				for (c = 0; k + c < n; c++)                                           \
+					x[c] = p[c];                                                  \
+			}                                                                             \
+			if (march_check_##_b(p, s, c, x, r0, r1, config, errors) < 0)                 \
+				return -1;                                                            \
+			break;                                                                        \
+		case MARCH_RW:                                                                        \
+			if (c == 4) {                                                                 \
+				x[0] = p[0];   p[0]   = w0;                                           \
+				x[1] = p[s];   p[s]   = w0;                                           \
+				x[2] = p[2*s]; p[2*s] = w0;                                           \
+				x[3] = p[3*s]; p[3*s] = w0;                                           \
+				if (((x[0] ^ r0) | (x[1] ^ r0) | (x[2] ^ r0) | (x[3] ^ r0)) == 0)     \
+					break;                                                        \
+			} else {                                                                      \
+				for (c = 0; k + c < n; c++) {                                         \
+					x[c] = p[c*s]; p[c*s] = w0;                                   \
+				}                                                                     \
+			}                                                                             \
+			if (march_check_##_b(p, s, c, x, r0, r0, config, errors) < 0)                 \
+				return -1;                                                            \
+			break;                                                                        \
+		case MARCH_SS:                                                                        \
+			for (c = 0; (c < 4) && (k + c < n); c++) {                                    \
+				x[c] = p[c*s];                                                        \
+				y[c] = p[c*s];                                                        \
+				p[c*s] = r0;                                                          \
+				z[c] = p[c*s];                                                        \
+				p[c*s] = w0;                                                          \
+			}                                                                             \
+			if ((c == 4) &&                                                               \
+			    (((x[0] ^ r0) | (y[0] ^ r0) | (z[0] ^ r0) |                               \
+			      (x[1] ^ r0) | (y[1] ^ r0) | (z[1] ^ r0) |                               \
+			      (x[2] ^ r0) | (y[2] ^ r0) | (z[2] ^ r0) |                               \
+			      (x[3] ^ r0) | (y[3] ^ r0) | (z[3] ^ r0)) == 0))                         \
+				break;                                                                \
+			if ((march_check_##_b(p, s, c, x, r0, r0, config, errors) < 0) ||            \
+			    (march_check_##_b(p, s, c, y, r0, r0, config, errors) < 0) ||            \
+			    (march_check_##_b(p, s, c, z, r0, r0, config, errors) < 0))              \
+				return -1;                                                            \
+			break;                                                                        \
+		}                                                                                     \
+	}                                                                                             \
+	return 0;                                                                                     \
+}
+
+MARCH_FUNCS(8)
+MARCH_FUNCS(16)
+MARCH_FUNCS(32)
+#if __SIZEOF_LONG__ == 8
+MARCH_FUNCS(64)
+#endif
+
+int memtest_march(unsigned int *addr, unsigned long size, int algo, int width, struct memtest_config *config)
+{
+	const struct march_algo *a;
+	unsigned long n;
+	int errors;
+	int progress;
+	int i, ret;
+
+	if ((algo < 0) || (algo >= MEMTEST_ALGOS))
+		return -1;
+	if ((width != 1) && (width != 2) && (width != 4) && (width != 8))
+		return -1;
+	if ((unsigned int) width > sizeof(unsigned long))
+		return -1;
+
+	a        = &march_algos[algo];
+	n        = size/width;
+	errors   = 0;
+	progress = config == NULL ? 1 : config->show_progress;
+
+	for (i = 0; i < a->nelements; i++) {
+		if (progress)
+			printf("  %s: %d/%d   \r", a->name, i + 1, a->nelements);
+		switch (width) {
+		case 1:
+			ret = march_element_8((volatile uint8_t *) addr, n, &a->elements[i], a->bg, config, &errors);
+			break;
+		case 2:
+			ret = march_element_16((volatile uint16_t *) addr, n, &a->elements[i], a->bg, config, &errors);
+			break;
+		case 4:
+			ret = march_element_32((volatile uint32_t *) addr, n, &a->elements[i], a->bg, config, &errors);
+			break;
+#if __SIZEOF_LONG__ == 8
+		case 8:
+			ret = march_element_64((volatile uint64_t *) addr, n, &a->elements[i], a->bg, config, &errors);
+			break;
+#endif
+		default:
+			ret = -1;
+			break;
+		}
+		if (ret < 0)
+			break;
+
+		/* Flush caches */
+		flush_cpu_dcache();
+		flush_l2_cache();
+	}
+	if (progress)
+		printf("\n");
+
+	return errors;
+}
+
 void memspeed(unsigned int *addr, unsigned long size, bool read_only, bool random)
 {
 	volatile unsigned long *array = (unsigned long *)addr;
@@ -345,6 +714,236 @@ void memspeed(unsigned int *addr, unsigned long size, bool read_only, bool rando
 	printf("\n");
 }
 
+/* Memory characterization (mem_bench): latency (pointer chasing) across working-set sizes,
+   stride sweep, sequential read/write/copy and random read bandwidths. Everything that is not
+   measured (permutations, LFSR) is prepared before the timed loops. */
+
+#define MEMBENCH_NODE_SIZE  64      /* Pointer chasing: one node per (typical) cache line */
+#define MEMBENCH_MIN_SIZE   (1*KIB)
+#define MEMBENCH_MIN_ACCESS (64*KIB) /* Minimum number of accesses per measurement */
+#define MEMBENCH_CHASE_BATCH (64*KIB) /* Pointer chasing accesses per 32-bit timer difference */
+
+/* Free-running (reloaded) down-counter, measurements are wrap-safe 32-bit differences (taken
+   before the counter wraps), accumulated in 64-bit on long measurements. */
+static void membench_timer_init(void)
+{
+	timer0_en_write(0);
+	timer0_reload_write(0xffffffff);
+	timer0_load_write(0xffffffff);
+	timer0_en_write(1);
+}
+
+static uint32_t membench_timer_read(void)
+{
+	timer0_update_value_write(1);
+	return timer0_value_read();
+}
+
+static unsigned long membench_speed(uint64_t bytes, uint32_t ticks)
+{
+	if (ticks == 0)
+		return 0;
+	return bytes*CONFIG_CLOCK_FREQUENCY/ticks/MIB;
+}
+
+/* Cycles per access (x10). */
+static unsigned long membench_cycles(uint64_t ticks, unsigned long accesses)
+{
+	return ticks*10/accesses;
+}
+
+static void membench_print_cycles(unsigned long cycles)
+{
+	unsigned long ns = ((uint64_t) cycles)*1000000000/CONFIG_CLOCK_FREQUENCY;
+	printf("%7lu.%lu %7lu.%lu\n", cycles/10, cycles%10, ns/10, ns%10);
+}
+
+static void membench_flush(void)
+{
+	flush_cpu_dcache();
+	flush_l2_cache();
+}
+
+/* Build a random cyclic chain (Sattolo's shuffle) of the nodes of [addr, addr + size). */
+static void membench_chain(unsigned char *addr, unsigned long size)
+{
+	unsigned long nodes = size/MEMBENCH_NODE_SIZE;
+	unsigned long i, j, tmp;
+	unsigned long seed = 1;
+
+	for (i = 0; i < nodes; i++)
+		*(unsigned long *) (addr + i*MEMBENCH_NODE_SIZE) = i;
+	for (i = nodes - 1; i > 0; i--) {
+		seed = lfsr(32, seed);
+		j    = seed % i;
+		tmp  = *(unsigned long *) (addr + i*MEMBENCH_NODE_SIZE);
+		*(unsigned long *) (addr + i*MEMBENCH_NODE_SIZE) = *(unsigned long *) (addr + j*MEMBENCH_NODE_SIZE);
+		*(unsigned long *) (addr + j*MEMBENCH_NODE_SIZE) = tmp;
+	}
+	/* Indexes to pointers */
+	for (i = 0; i < nodes; i++) {
+		j = *(unsigned long *) (addr + i*MEMBENCH_NODE_SIZE);
+		*(unsigned long *) (addr + i*MEMBENCH_NODE_SIZE) = (unsigned long) (addr + j*MEMBENCH_NODE_SIZE);
+	}
+}
+
+static uint64_t membench_chase(unsigned char *addr, unsigned long accesses)
+{
+	volatile unsigned long *p = (volatile unsigned long *) addr;
+	unsigned long i, j, n;
+	uint32_t start, end;
+	uint64_t ticks = 0;
+
+	for (i = 0; i < accesses; i += n) {
+		n = min(accesses - i, MEMBENCH_CHASE_BATCH);
+		start = membench_timer_read();
+		for (j = 0; j < n; j += 8) {
+			p = (volatile unsigned long *) *p; p = (volatile unsigned long *) *p;
+			p = (volatile unsigned long *) *p; p = (volatile unsigned long *) *p;
+			p = (volatile unsigned long *) *p; p = (volatile unsigned long *) *p;
+			p = (volatile unsigned long *) *p; p = (volatile unsigned long *) *p;
+		}
+		end = membench_timer_read();
+		ticks += (uint32_t) (start - end);
+	}
+
+	return ticks;
+}
+
+static void membench_latency(unsigned char *addr, unsigned long size)
+{
+	unsigned long ws, accesses;
+	uint64_t ticks;
+
+	printf("Latency (pointer chasing, %dB nodes):\n", MEMBENCH_NODE_SIZE);
+	printf("  Size(KiB)  Cycles      ns\n");
+	for (ws = MEMBENCH_MIN_SIZE; ws <= size; ws <<= 1) {
+		accesses = max(ws/MEMBENCH_NODE_SIZE, MEMBENCH_MIN_ACCESS);
+		membench_chain(addr, ws);
+		/* Warm the caches, then measure */
+		membench_chase(addr, ws/MEMBENCH_NODE_SIZE);
+		ticks = membench_chase(addr, accesses);
+		printf("  %9lu ", ws/KIB);
+		membench_print_cycles(membench_cycles(ticks, accesses));
+		if (ws > (~0UL >> 1))
+			break;
+	}
+}
+
+static void membench_stride(unsigned char *addr, unsigned long size)
+{
+	__attribute__((unused)) unsigned long data;
+	unsigned long stride, offset, accesses;
+	uint32_t start, end;
+	uint64_t ticks;
+
+	printf("Stride (read, %luKiB):\n", size/KIB);
+	printf("  Stride(B)  Cycles      ns\n");
+	for (stride = sizeof(unsigned long); stride <= 4*KIB && stride < size; stride <<= 1) {
+		membench_flush();
+		accesses = 0;
+		ticks    = 0;
+		do {
+			start = membench_timer_read();
+			for (offset = 0; offset < size; offset += stride)
+				data = *(volatile unsigned long *) (addr + offset);
+			end = membench_timer_read();
+			ticks    += (uint32_t) (start - end);
+			accesses += size/stride;
+		} while (accesses < MEMBENCH_MIN_ACCESS);
+		printf("  %9lu ", stride);
+		membench_print_cycles(membench_cycles(ticks, accesses));
+	}
+}
+
+static void membench_bandwidth(unsigned char *addr, unsigned long size)
+{
+	volatile unsigned long *src = (unsigned long *) addr;
+	volatile unsigned long *dst = (unsigned long *) (addr + size/2);
+	unsigned int *indexes       = (unsigned int *) (addr + size/2);
+	__attribute__((unused)) unsigned long data;
+	unsigned long words = size/sizeof(unsigned long);
+	unsigned long half  = words/2;
+	unsigned long n, i, seed;
+	uint32_t start, end;
+	unsigned long rd_speed, wr_speed, cp_speed, rnd_speed;
+
+	/* Write */
+	membench_flush();
+	start = membench_timer_read();
+	for (i = 0; i + 4 <= words; i += 4) {
+		src[i + 0] = i;
+		src[i + 1] = i;
+		src[i + 2] = i;
+		src[i + 3] = i;
+	}
+	end = membench_timer_read();
+	wr_speed = membench_speed(i*sizeof(unsigned long), start - end);
+
+	/* Read */
+	membench_flush();
+	start = membench_timer_read();
+	for (i = 0; i + 4 <= words; i += 4) {
+		data = src[i + 0];
+		data = src[i + 1];
+		data = src[i + 2];
+		data = src[i + 3];
+	}
+	end = membench_timer_read();
+	rd_speed = membench_speed(i*sizeof(unsigned long), start - end);
+
+	/* Copy (first half to second half, bytes read + written) */
+	membench_flush();
+	start = membench_timer_read();
+	for (i = 0; i + 4 <= half; i += 4) {
+		dst[i + 0] = src[i + 0];
+		dst[i + 1] = src[i + 1];
+		dst[i + 2] = src[i + 2];
+		dst[i + 3] = src[i + 3];
+	}
+	end = membench_timer_read();
+	cp_speed = membench_speed(2*i*sizeof(unsigned long), start - end);
+
+	/* Random read: precomputed indexes (second half) of words of the first half */
+	n    = min((size/2)/sizeof(unsigned int), half);
+	seed = 1;
+	for (i = 0; i < n; i++) {
+		seed = lfsr(32, seed);
+		indexes[i] = seed % half;
+	}
+	membench_flush();
+	start = membench_timer_read();
+	for (i = 0; i + 4 <= n; i += 4) {
+		data = src[indexes[i + 0]];
+		data = src[indexes[i + 1]];
+		data = src[indexes[i + 2]];
+		data = src[indexes[i + 3]];
+	}
+	end = membench_timer_read();
+	rnd_speed = membench_speed(i*sizeof(unsigned long), start - end);
+
+	printf("Bandwidth (%luKiB, MiB/s):\n", size/KIB);
+	printf("       Read      Write       Copy     Random\n");
+	printf(" %10lu %10lu %10lu %10lu\n", rd_speed, wr_speed, cp_speed, rnd_speed);
+}
+
+void membench(unsigned int *addr, unsigned long size)
+{
+	printf("Membench at %p (", addr);
+	print_size(size);
+	printf(")...\n");
+
+	if (size < MEMBENCH_MIN_SIZE) {
+		printf("Size must be >= %dKiB\n", MEMBENCH_MIN_SIZE/KIB);
+		return;
+	}
+
+	membench_timer_init();
+	membench_latency((unsigned char *) addr, size);
+	membench_stride((unsigned char *) addr, size);
+	membench_bandwidth((unsigned char *) addr, size);
+}
+
 int memtest(unsigned int *addr, unsigned long maxsize)
 {
 	int bus_errors, data_errors, addr_errors;
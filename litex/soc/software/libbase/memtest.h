@@ -30,7 +30,21 @@ int memtest_bus(unsigned int *addr, unsigned long size);
 int memtest_addr(unsigned int *addr, unsigned long size, int random);
 int memtest_data(unsigned int *addr, unsigned long size, int random, struct memtest_config *config);
 
+// March C-, March SS and Checkerboard tests with width-byte accesses (1, 2, 4 or 8
+// up to sizeof(unsigned long)). Returns the number of errors or -1 on invalid algo/width.
+enum {
+	MEMTEST_MARCH_C,
+	MEMTEST_MARCH_SS,
+	MEMTEST_CHECKERBOARD,
+	MEMTEST_ALGOS,
+};
+const char *memtest_algo_name(int algo);
+int memtest_algo_from_name(const char *name);
+int memtest_march(unsigned int *addr, unsigned long size, int algo, int width, struct memtest_config *config);
+
 void memspeed(unsigned int *addr, unsigned long size, bool read_only, bool random);
+// Latency (per working-set size), stride and read/write/copy/random bandwidth tables.
+void membench(unsigned int *addr, unsigned long size);
 int memtest(unsigned int *addr, unsigned long maxsize);
 
 #endif /* __MEMTEST_H */
@@ -9,6 +9,10 @@
 #include <uart.h>
 #include <time.h>
 #include <console.h>
+#include <system.h>
+
+#include <generated/mem.h>
+#include <libbase/memtest.h>
 
 #include <liblitedram/bist.h>
 
@@ -178,4 +182,174 @@ void sdram_bist(uint32_t burst_length, uint32_t random)
 	}
 }
 
+/* Full memory test: the generator/checker sweep the memory in SDRAM_BIST_MEMTEST_CHUNK chunks,
+   the generator writing the next chunk while the checker verifies the current one. Chunks with
+   errors are then retested with the CPU to report the error addresses. */
+
+#ifndef SDRAM_BIST_MEMTEST_CHUNK
+#define SDRAM_BIST_MEMTEST_CHUNK (16*1024*1024)
+#endif
+#ifndef SDRAM_BIST_MEMTEST_MAX_ERRORS
+#define SDRAM_BIST_MEMTEST_MAX_ERRORS 16
+#endif
+
+static void sdram_bist_generator_setup(unsigned long base, unsigned long length)
+{
+	sdram_generator_reset_write(1);
+	sdram_generator_reset_write(0);
+	sdram_generator_random_write(1); /* Random data */
+	sdram_generator_base_write(base);
+	sdram_generator_end_write((uint64_t) base + length); /* 64-bit: end of a 4GiB memory */
+	sdram_generator_length_write(length);
+	cdelay(100);
+}
+
+static void sdram_bist_checker_setup(unsigned long base, unsigned long length)
+{
+	sdram_checker_reset_write(1);
+	sdram_checker_reset_write(0);
+	sdram_checker_random_write(1); /* Random data */
+	sdram_checker_base_write(base);
+	sdram_checker_end_write((uint64_t) base + length);
+	sdram_checker_length_write(length);
+	cdelay(100);
+}
+
+static void sdram_bist_print_size(uint64_t size)
+{
+	if (size >= 1024*1024)
+		printf("%luMiB", (unsigned long) (size/(1024*1024)));
+	else
+		printf("%luKiB", (unsigned long) (size/1024));
+}
+
+static int sdram_bist_memtest_error(unsigned int addr, unsigned int rdata, unsigned int refdata, void *arg)
+{
+	int *errors = arg;
+
+	(*errors)++;
+	if (*errors <= SDRAM_BIST_MEMTEST_MAX_ERRORS)
+		printf("  error @ 0x%08x: 0x%08x vs 0x%08x\n", addr, rdata, refdata);
+	return 0;
+}
+
+/* The data of the generator/checker restarts with each chunk: check the address lines above the
+   chunk size with the CPU (walking ones). */
+static int sdram_bist_memtest_addr(unsigned long base, unsigned long size, unsigned long chunk)
+{
+	volatile unsigned char *array = (unsigned char *) (MAIN_RAM_BASE + base);
+	unsigned long offset;
+	uint32_t rdata;
+	int errors;
+
+	errors = 0;
+	*(volatile uint32_t *) array = 0;
+	for (offset = chunk; (offset != 0) && (offset < size); offset <<= 1)
+		*(volatile uint32_t *) (array + offset) = offset/4;
+
+	/* Flush caches */
+	flush_cpu_dcache();
+	flush_l2_cache();
+
+	for (offset = chunk; (offset != 0) && (offset < size); offset <<= 1) {
+		rdata = *(volatile uint32_t *) (array + offset);
+		if (rdata != offset/4) {
+			errors++;
+			printf("  address error @ 0x%08lx: 0x%08x vs 0x%08x\n",
+				(unsigned long) (array + offset), (unsigned int) rdata, (unsigned int) (offset/4));
+		}
+	}
+	if (*(volatile uint32_t *) array != 0)
+		errors++;
+
+	return errors;
+}
+
+int sdram_bist_memtest(unsigned long base, unsigned long size)
+{
+	struct memtest_config config;
+	uint64_t wr_total_ticks, rd_total_ticks;
+	unsigned long chunk, chunks;
+	unsigned long i;
+	uint32_t errors, chunk_errors;
+	int cpu_errors;
+
+	chunk = (size < SDRAM_BIST_MEMTEST_CHUNK) ? size : SDRAM_BIST_MEMTEST_CHUNK;
+	chunk = chunk - (chunk % SDRAM_TEST_DATA_BYTES);
+	if (chunk == 0)
+		return 0;
+	chunks = size/chunk;
+
+	printf("Memtest (BIST) at 0x%08lx (", (unsigned long) MAIN_RAM_BASE + base);
+	sdram_bist_print_size((uint64_t) chunks*chunk);
+	printf(")...\n");
+
+	errors         = 0;
+	wr_total_ticks = 0;
+	rd_total_ticks = 0;
+
+	/* Write first chunk */
+	sdram_bist_generator_setup(base, chunk);
+	sdram_generator_start_write(1);
+	while(sdram_generator_done_read() == 0);
+	wr_total_ticks += sdram_generator_ticks_read();
+
+	for(i=0; i<chunks; i++) {
+		/* Start read of chunk i */
+		sdram_bist_checker_setup(base + i*chunk, chunk);
+		sdram_checker_start_write(1);
+		/* Start write of chunk i + 1 during the read */
+		if (i + 1 < chunks) {
+			sdram_bist_generator_setup(base + (i + 1)*chunk, chunk);
+			sdram_generator_start_write(1);
+		}
+		/* Wait read */
+		while(sdram_checker_done_read() == 0);
+		rd_total_ticks += sdram_checker_ticks_read();
+		chunk_errors = sdram_checker_errors_read();
+		/* Wait write */
+		if (i + 1 < chunks) {
+			while(sdram_generator_done_read() == 0);
+			wr_total_ticks += sdram_generator_ticks_read();
+		}
+
+		/* Errors: retest the chunk with the CPU to get the addresses */
+		if (chunk_errors != 0) {
+			printf("  chunk 0x%08lx: %u errors\n", (unsigned long) MAIN_RAM_BASE + base + i*chunk, (unsigned int) chunk_errors);
+			cpu_errors         = 0;
+			config.show_progress = 0;
+			config.read_only     = 0;
+			config.on_error      = sdram_bist_memtest_error;
+			config.arg           = &cpu_errors;
+			flush_cpu_dcache();
+			flush_l2_cache();
+			memtest_data((unsigned int *) (MAIN_RAM_BASE + base + i*chunk), chunk, 1, &config);
+			if (cpu_errors == 0)
+				printf("  (not reproduced by CPU memtest)\n");
+			errors += chunk_errors;
+		}
+		printf("  BIST: ");
+		sdram_bist_print_size((uint64_t) (i + 1)*chunk);
+		printf("/");
+		sdram_bist_print_size((uint64_t) chunks*chunk);
+		printf("   \r");
+	}
+	printf("\n");
+
+	/* Address lines above the chunk size */
+	errors += sdram_bist_memtest_addr(base, chunks*chunk, chunk);
+
+	if (wr_total_ticks != 0 && rd_total_ticks != 0)
+		printf("  Write speed: %luMiB/s, Read speed: %luMiB/s\n",
+			(unsigned long) ((uint64_t) chunks*chunk*CONFIG_CLOCK_FREQUENCY/wr_total_ticks/(1024*1024)),
+			(unsigned long) ((uint64_t) chunks*chunk*CONFIG_CLOCK_FREQUENCY/rd_total_ticks/(1024*1024)));
+	if (errors != 0) {
+		printf("  errors: %u\n", (unsigned int) errors);
+		printf("Memtest (BIST) KO\n");
+	} else
+		printf("Memtest (BIST) OK\n");
+
+	return errors;
+}
+
 #endif
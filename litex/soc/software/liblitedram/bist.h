@@ -4,7 +4,13 @@
 #ifndef __SDRAM_BIST_H
 #define __SDRAM_BIST_H
 
+#include <stdint.h>
+
 void sdram_bist_loop(uint32_t loop, uint32_t burst_length, uint32_t random);
 void sdram_bist(uint32_t burst_length, uint32_t random);
 
+/* Full-speed memtest of [base, base + size) (SDRAM addresses) with the generator/checker,
+   returns the number of errors. */
+int sdram_bist_memtest(unsigned long base, unsigned long size);
+
 #endif /* __SDRAM_BIST_H */
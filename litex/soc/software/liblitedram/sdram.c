@@ -26,11 +26,14 @@
 
 #include <liblitedram/sdram.h>
 #include <liblitedram/sdram_dbg.h>
+#include <liblitedram/bist.h>
 
 //#define SDRAM_TEST_DISABLE
+//#define SDRAM_TEST_BIST
 //#define SDRAM_WRITE_LEVELING_CMD_DELAY_DEBUG
 //#define SDRAM_WRITE_LATENCY_CALIBRATION_DEBUG
 //#define SDRAM_LEVELING_SCAN_DISPLAY_HEX_DIV 10
+//#define SDRAM_LEVELING_COARSE_STEP 16
 
 #ifdef CSR_SDRAM_BASE
 
@@ -257,6 +260,48 @@ void sdram_mode_register_write(char reg, int value) {
 
 typedef void (*delay_callback)(int module);
 
+/* Selection of all the modules: delays/bitslips of the selected modules are reset/incremented together,
+   which allows scanning all the modules in lock-step. */
+#define SDRAM_PHY_MODULES_SEL ((1 << SDRAM_PHY_MODULES) - 1)
+
+/* Coarse-to-fine delay scans: windows are first searched every SDRAM_LEVELING_COARSE_STEP taps (power
+   of 2), then their edges are refined tap by tap. 1 (default with few delays) for exhaustive scans, also
+   forced at runtime with sdram_leveling_set_full_scan (sdram_cal full). */
+#ifndef SDRAM_LEVELING_COARSE_STEP
+#if SDRAM_PHY_DELAYS > 32
+#define SDRAM_LEVELING_COARSE_STEP 16
+#else
+#define SDRAM_LEVELING_COARSE_STEP 1
+#endif
+#endif
+
+static int sdram_leveling_full_scan = 0;
+
+void sdram_leveling_set_full_scan(int full) {
+	sdram_leveling_full_scan = full;
+}
+
+static int sdram_leveling_scan_step(void) {
+	return sdram_leveling_full_scan ? 1 : SDRAM_LEVELING_COARSE_STEP;
+}
+
+/* Taps displayed on scans (only coarse taps are displayed) */
+#if SDRAM_PHY_DELAYS > 32
+#define SDRAM_LEVELING_SCAN_SHOW_STEP max(16, SDRAM_LEVELING_COARSE_STEP)
+#else
+#define SDRAM_LEVELING_SCAN_SHOW_STEP SDRAM_LEVELING_COARSE_STEP
+#endif
+#define SDRAM_LEVELING_SCAN_SHOW_TAPS ((SDRAM_PHY_DELAYS + SDRAM_LEVELING_SCAN_SHOW_STEP - 1)/SDRAM_LEVELING_SCAN_SHOW_STEP)
+
+/* Jump into the working zone once its start has been found */
+#if SDRAM_PHY_DELAYS > 32
+	#define	SDRAM_PHY_DELAY_JUMP 16
+#elif SDRAM_PHY_DELAYS > 8
+	#define SDRAM_PHY_DELAY_JUMP 4
+#else
+	#define SDRAM_PHY_DELAY_JUMP 1
+#endif
+
 static void sdram_activate_test_row(void) {
 	sdram_dfii_pi0_address_write(0);
 	sdram_dfii_pi0_baddress_write(0);
@@ -299,12 +344,17 @@ static void print_scan_errors(unsigned int errors) {
 
 #define READ_CHECK_TEST_PATTERN_MAX_ERRORS (8*SDRAM_PHY_PHASES*DFII_PIX_DATA_BYTES/SDRAM_PHY_MODULES)
 
-static unsigned int sdram_write_read_check_test_pattern(int module, unsigned int seed) {
-	int p, i;
-	unsigned int errors;
+/* Write/Read/Check a pseudo-random burst, accumulating the errors of each module in errors[]. All
+   the modules are checked from the same burst, which allows leveling them in lock-step. */
+static void sdram_write_read_check_test_pattern_modules(unsigned int seed, unsigned int *errors) {
+	int p, i, j;
 	unsigned int prv;
 	unsigned char tst[DFII_PIX_DATA_BYTES];
 	unsigned char prs[SDRAM_PHY_PHASES][DFII_PIX_DATA_BYTES];
+#if defined(SDRAM_PHY_ECP5DDRPHY) || defined(SDRAM_PHY_GW2DDRPHY)
+	int module;
+	unsigned int burstdet;
+#endif
 
 	/* Generate pseudo-random sequence */
 	prv = seed;
@@ -339,107 +389,122 @@ static unsigned int sdram_write_read_check_test_pattern(int module, unsigned int
 	/* Precharge */
 	sdram_precharge_test_row();
 
-	errors = 0;
 	for(p=0;p<SDRAM_PHY_PHASES;p++) {
 		/* Read back test pattern */
 		csr_rd_buf_uint8(sdram_dfii_pix_rddata_addr(p), tst, DFII_PIX_DATA_BYTES);
-		/* Verify bytes matching current 'module' */
-		for (int i = 0; i < DFII_PIX_DATA_BYTES; ++i) {
-			int j = p * DFII_PIX_DATA_BYTES + i;
+		/* Verify bytes, accumulating errors on their module */
+		for(i=0;i<DFII_PIX_DATA_BYTES;i++) {
+			j = p * DFII_PIX_DATA_BYTES + i;
 #if SDRAM_PHY_DQ_DQS_RATIO == 4
-			if (j % (SDRAM_PHY_MODULES/2) == ((SDRAM_PHY_MODULES-1)/2)-(module/2)) {
-				if(module % 2) {
-					errors += popcount((prs[p][i] & 0xf0) ^ (tst[i] & 0xf0));
-				} else {
-					errors += popcount((prs[p][i] & 0x0f) ^ (tst[i] & 0x0f));
-				}
-			}
+			j = 2*(((SDRAM_PHY_MODULES-1)/2) - (j % (SDRAM_PHY_MODULES/2)));
+			errors[j + 0] += popcount((prs[p][i] & 0x0f) ^ (tst[i] & 0x0f));
+			errors[j + 1] += popcount((prs[p][i] & 0xf0) ^ (tst[i] & 0xf0));
 #else
-			if (j % SDRAM_PHY_MODULES == SDRAM_PHY_MODULES-1-module) {
-				errors += popcount(prs[p][i] ^ tst[i]);
-			}
+			errors[SDRAM_PHY_MODULES-1-(j % SDRAM_PHY_MODULES)] += popcount(prs[p][i] ^ tst[i]);
 #endif
 		}
 	}
 
 #if defined(SDRAM_PHY_ECP5DDRPHY) || defined(SDRAM_PHY_GW2DDRPHY)
-	if (((ddrphy_burstdet_seen_read() >> module) & 0x1) != 1)
-		errors += 1;
+	burstdet = ddrphy_burstdet_seen_read();
+	for(module=0;module<SDRAM_PHY_MODULES;module++)
+		if (((burstdet >> module) & 0x1) != 1)
+			errors[module] += 1;
 #endif
+}
+
+static unsigned int sdram_write_read_check_test_pattern(int module, unsigned int seed) {
+	unsigned int errors[SDRAM_PHY_MODULES] = {0};
+
+	sdram_write_read_check_test_pattern_modules(seed, errors);
 
-	return errors;
+	return errors[module];
 }
 
-static void sdram_leveling_center_module(
+static void sdram_leveling_set_module_delay(
+	int module, int *current, int delay, delay_callback rst_delay, delay_callback inc_delay)
+{
+	/* Delays can only be incremented, reset to go back */
+	if (delay < *current) {
+		rst_delay(module);
+		*current = 0;
+	}
+	while (*current < delay) {
+		inc_delay(module);
+		(*current)++;
+	}
+}
+
+static int sdram_leveling_check_module(
+	int module, int delay, int show, int *current, delay_callback rst_delay, delay_callback inc_delay)
+{
+	unsigned int errors;
+
+	sdram_leveling_set_module_delay(module, current, delay, rst_delay, inc_delay);
+	errors  = sdram_write_read_check_test_pattern(module, 42);
+	errors += sdram_write_read_check_test_pattern(module, 84);
+	if (show)
+		print_scan_errors(errors);
+
+	return errors == 0;
+}
+
+__attribute__((unused)) static void sdram_leveling_center_module(
 	int module, int show_short, int show_long, delay_callback rst_delay, delay_callback inc_delay)
 {
 	int i;
+	int step;
 	int show;
-	int working;
 	unsigned int errors;
 	int delay, delay_mid, delay_range;
 	int delay_min = -1, delay_max = -1;
+	int delay_last;
+	int current;
 
 	if (show_long)
 		printf("m%d: |", module);
 
-	/* Find smallest working delay */
-	delay = 0;
+	step    = sdram_leveling_scan_step();
+	current = 0;
 	rst_delay(module);
-	while(1) {
-		errors  = sdram_write_read_check_test_pattern(module, 42);
-		errors += sdram_write_read_check_test_pattern(module, 84);
-		working = errors == 0;
-		show = show_long;
-#if SDRAM_PHY_DELAYS > 32
-		show = show && (delay%16 == 0);
-#endif
-		if (show)
-			print_scan_errors(errors);
-		if(working && delay_min < 0) {
+
+	/* Find smallest working delay (every step taps, then refined in the last step) */
+	for(delay=0; delay<SDRAM_PHY_DELAYS; delay+=step) {
+		show = show_long && (delay%SDRAM_LEVELING_SCAN_SHOW_STEP == 0);
+		if (sdram_leveling_check_module(module, delay, show, &current, rst_delay, inc_delay)) {
 			delay_min = delay;
 			break;
 		}
-		delay++;
-		if(delay >= SDRAM_PHY_DELAYS)
-			break;
-		inc_delay(module);
 	}
-
-	/* Get a bit further into the working zone */
-#if SDRAM_PHY_DELAYS > 32
-	#define	SDRAM_PHY_DELAY_JUMP 16
-#elif SDRAM_PHY_DELAYS > 8
-	#define SDRAM_PHY_DELAY_JUMP 4
-#else
-	#define SDRAM_PHY_DELAY_JUMP 1
-#endif
-	for(i=0;i<SDRAM_PHY_DELAY_JUMP;i++) {
-		delay += 1;
-		inc_delay(module);
+	if (delay_min > 0) {
+		for(delay=max(delay_min-step+1, 0); delay<delay_min; delay++) {
+			if (sdram_leveling_check_module(module, delay, 0, &current, rst_delay, inc_delay)) {
+				delay_min = delay;
+				break;
+			}
+		}
 	}
 
-	/* Find largest working delay */
-	while(1) {
-		errors  = sdram_write_read_check_test_pattern(module, 42);
-		errors += sdram_write_read_check_test_pattern(module, 84);
-		working = errors == 0;
-		show = show_long;
-#if SDRAM_PHY_DELAYS > 32
-		show = show && (delay%16 == 0);
-#endif
-		if (show)
-			print_scan_errors(errors);
-		if(!working && delay_max < 0) {
-			delay_max = delay;
+	/* Find largest working delay, a bit further into the working zone (every step taps, then
+	   refined in the last step) */
+	if (delay_min >= 0) {
+		delay_last = delay_min + SDRAM_PHY_DELAY_JUMP - 1;
+		for(delay=(delay_last+step) & ~(step-1); delay<SDRAM_PHY_DELAYS; delay+=step) {
+			show = show_long && (delay%SDRAM_LEVELING_SCAN_SHOW_STEP == 0);
+			if (!sdram_leveling_check_module(module, delay, show, &current, rst_delay, inc_delay)) {
+				delay_max = delay;
+				break;
+			}
+			delay_last = delay;
+		}
+		if (delay_max < 0)
+			delay_max = SDRAM_PHY_DELAYS;
+		for(delay=delay_last+1; delay<delay_max; delay++) {
+			if (!sdram_leveling_check_module(module, delay, 0, &current, rst_delay, inc_delay)) {
+				delay_max = delay;
+				break;
+			}
 		}
-		delay++;
-		if(delay >= SDRAM_PHY_DELAYS)
-			break;
-		inc_delay(module);
-	}
-	if(delay_max < 0) {
-		delay_max = delay;
 	}
 
 	if (show_long)
@@ -594,135 +659,132 @@ static void sdram_write_leveling_rst_delay(int module) {
 	ddrphy_dly_sel_write(0);
 }
 
-static void sdram_write_leveling_inc_delay(int module) {
-	/* Select module */
-	ddrphy_dly_sel_write(1 << module);
+static void sdram_write_leveling_inc_delay_sel(unsigned int sel) {
+	/* Select modules */
+	ddrphy_dly_sel_write(sel);
 
 	/* Increment DQ/DQS delay */
 	ddrphy_wdly_dq_inc_write(1);
 	ddrphy_wdly_dqs_inc_write(1);
 
-	/* Un-select module */
+	/* Un-select modules */
 	ddrphy_dly_sel_write(0);
 }
 
+/* Per-module state of a lock-step write leveling scan */
+struct sdram_write_leveling_scan {
+	int one_count;
+	int one_window_active;
+	int one_window_start, one_window_best_start;
+	int one_window_count, one_window_best_count;
+	unsigned char taps[SDRAM_LEVELING_SCAN_SHOW_TAPS];
+};
+
 static int sdram_write_leveling_scan(int *delays, int loops, int show)
 {
 	int i, j, k;
 
 	int err_ddrphy_wdly;
 
-	unsigned char taps_scan[SDRAM_PHY_DELAYS];
-
-	int one_window_active;
-	int one_window_start, one_window_best_start;
-	int one_window_count, one_window_best_count;
+	struct sdram_write_leveling_scan scans[SDRAM_PHY_MODULES];
+	struct sdram_write_leveling_scan *scan;
+	int tap;
 
 	unsigned char buf[DFII_PIX_DATA_BYTES];
 
+	unsigned int sel;
 	int ok;
 
 	err_ddrphy_wdly = SDRAM_PHY_DELAYS - _sdram_tck_taps/4;
 
 	sdram_write_leveling_on();
 	cdelay(100);
-	for(i=0;i<SDRAM_PHY_MODULES;i++) {
-		if (show)
-			printf("  m%d: |", i);
 
-		/* Reset delay */
+	/* Reset delays */
+	for(i=0;i<SDRAM_PHY_MODULES;i++) {
 		sdram_write_leveling_rst_delay(i);
-		cdelay(100);
+		scans[i].one_window_active     = 0;
+		scans[i].one_window_start      = 0;
+		scans[i].one_window_count      = 0;
+		scans[i].one_window_best_start = 0;
+		scans[i].one_window_best_count = -1;
+	}
+	cdelay(100);
 
-		/* Scan write delay taps */
-		for(j=0;j<err_ddrphy_wdly;j++) {
-			int zero_count = 0;
-			int one_count = 0;
-			int show_iter = show;
-#if SDRAM_PHY_DELAYS > 32
-			show_iter = (j%16 == 0) && show;
-#endif
-			for (k=0; k<loops; k++) {
-				ddrphy_wlevel_strobe_write(1);
-				cdelay(100);
-				csr_rd_buf_uint8(sdram_dfii_pix_rddata_addr(0), buf, DFII_PIX_DATA_BYTES);
+	/* Scan write delay taps, all modules in lock-step: each strobe samples all the modules */
+	for(j=0;j<err_ddrphy_wdly;j++) {
+		for(i=0;i<SDRAM_PHY_MODULES;i++)
+			scans[i].one_count = 0;
+		for (k=0; k<loops; k++) {
+			ddrphy_wlevel_strobe_write(1);
+			cdelay(100);
+			csr_rd_buf_uint8(sdram_dfii_pix_rddata_addr(0), buf, DFII_PIX_DATA_BYTES);
+			for(i=0;i<SDRAM_PHY_MODULES;i++) {
 #if SDRAM_PHY_DQ_DQS_RATIO == 4
 				if (buf[SDRAM_PHY_MODULES-1-(i/2)] != 0)
 #else
 				if (buf[SDRAM_PHY_MODULES-1-i] != 0)
 #endif
-					one_count++;
-				else
-					zero_count++;
+					scans[i].one_count++;
 			}
-			if (one_count > zero_count)
-				taps_scan[j] = 1;
-			else
-				taps_scan[j] = 0;
-			if (show_iter)
-				printf("%d", taps_scan[j]);
-			sdram_write_leveling_inc_delay(i);
-			cdelay(100);
 		}
-		if (show)
-			printf("|");
-
-		/* Find longer 1 window and set delay at the 0/1 transition */
-		one_window_active = 0;
-		one_window_start = 0;
-		one_window_count = 0;
-		one_window_best_start = 0;
-		one_window_best_count = -1;
-		delays[i] = -1;
-		for(j=0;j<err_ddrphy_wdly;j++) {
-			if (one_window_active) {
-				if ((taps_scan[j] == 0) | (j == err_ddrphy_wdly - 1)) {
-					one_window_active = 0;
-					one_window_count = j - one_window_start;
-					if (one_window_count > one_window_best_count) {
-						one_window_best_start = one_window_start;
-						one_window_best_count = one_window_count;
+		for(i=0;i<SDRAM_PHY_MODULES;i++) {
+			scan = &scans[i];
+			tap  = scan->one_count > (loops - scan->one_count);
+			if (j%SDRAM_LEVELING_SCAN_SHOW_STEP == 0)
+				scan->taps[j/SDRAM_LEVELING_SCAN_SHOW_STEP] = tap;
+
+			/* Find longer 1 window */
+			if (scan->one_window_active) {
+				if ((tap == 0) | (j == err_ddrphy_wdly - 1)) {
+					scan->one_window_active = 0;
+					scan->one_window_count = j - scan->one_window_start;
+					if (scan->one_window_count > scan->one_window_best_count) {
+						scan->one_window_best_start = scan->one_window_start;
+						scan->one_window_best_count = scan->one_window_count;
 					}
 				}
 			} else {
-				if (taps_scan[j]) {
-					one_window_active = 1;
-					one_window_start = j;
+				if (tap) {
+					scan->one_window_active = 1;
+					scan->one_window_start = j;
 				}
 			}
 		}
+		sdram_write_leveling_inc_delay_sel(SDRAM_PHY_MODULES_SEL);
+		cdelay(100);
+	}
+
+	/* Set delay at the 0/1 transition */
+	for(i=0;i<SDRAM_PHY_MODULES;i++) {
+		scan = &scans[i];
+		if (show) {
+			printf("  m%d: |", i);
+			for(j=0;j<err_ddrphy_wdly;j+=SDRAM_LEVELING_SCAN_SHOW_STEP)
+				printf("%d", scan->taps[j/SDRAM_LEVELING_SCAN_SHOW_STEP]);
+			printf("|");
+		}
 
 		/* Reset delay */
 		sdram_write_leveling_rst_delay(i);
 		cdelay(100);
 
+		delays[i] = -1;
 		/* Use forced delay if configured */
 		if (_sdram_write_leveling_dat_delays[i] >= 0) {
 			delays[i] = _sdram_write_leveling_dat_delays[i];
-
-			/* Configure write delay */
-			for(j=0; j<delays[i]; j++)  {
-				sdram_write_leveling_inc_delay(i);
-				cdelay(100);
-			}
 		/* Succeed only if the start of a 1s window has been found: */
 		} else if (
 			/* Start of 1s window directly seen after 0. */
-			((one_window_best_start) > 0 && (one_window_best_count > 0)) ||
+			((scan->one_window_best_start) > 0 && (scan->one_window_best_count > 0)) ||
 			/* Start of 1s window indirectly seen before 0. */
-			((one_window_best_start == 0) && (one_window_best_count > _sdram_tck_taps/4))
+			((scan->one_window_best_start == 0) && (scan->one_window_best_count > _sdram_tck_taps/4))
 			){
 #if SDRAM_PHY_DELAYS > 32
 			/* Ensure write delay is just before transition */
-			one_window_start -= min(one_window_start, 16);
+			scan->one_window_start -= min(scan->one_window_start, 16);
 #endif
-			delays[i] = one_window_best_start;
-
-			/* Configure write delay */
-			for(j=0; j<delays[i]; j++) {
-				sdram_write_leveling_inc_delay(i);
-				cdelay(100);
-			}
+			delays[i] = scan->one_window_best_start;
 		}
 		if (show) {
 			if (delays[i] == -1)
@@ -732,6 +794,18 @@ static int sdram_write_leveling_scan(int *delays, int loops, int show)
 		}
 	}
 
+	/* Configure write delays, modules leave the selection once set */
+	for(j=0;;j++) {
+		sel = 0;
+		for(i=0;i<SDRAM_PHY_MODULES;i++)
+			if (j < delays[i])
+				sel |= (1 << i);
+		if (sel == 0)
+			break;
+		sdram_write_leveling_inc_delay_sel(sel);
+		cdelay(100);
+	}
+
 	sdram_write_leveling_off();
 
 	ok = 1;
@@ -884,14 +958,14 @@ int sdram_write_leveling(void)
 /* Read Leveling                                                         */
 /*-----------------------------------------------------------------------*/
 
-static void sdram_read_leveling_rst_delay(int module) {
-	/* Select module */
-	ddrphy_dly_sel_write(1 << module);
+static void sdram_read_leveling_rst_delay_sel(unsigned int sel) {
+	/* Select modules */
+	ddrphy_dly_sel_write(sel);
 
 	/* Reset delay */
 	ddrphy_rdly_dq_rst_write(1);
 
-	/* Un-select module */
+	/* Un-select modules */
 	ddrphy_dly_sel_write(0);
 
 #if defined(SDRAM_PHY_ECP5DDRPHY) || defined(SDRAM_PHY_GW2DDRPHY)
@@ -901,14 +975,14 @@ static void sdram_read_leveling_rst_delay(int module) {
 #endif
 }
 
-static void sdram_read_leveling_inc_delay(int module) {
-	/* Select module */
-	ddrphy_dly_sel_write(1 << module);
+static void sdram_read_leveling_inc_delay_sel(unsigned int sel) {
+	/* Select modules */
+	ddrphy_dly_sel_write(sel);
 
 	/* Increment delay */
 	ddrphy_rdly_dq_inc_write(1);
 
-	/* Un-select module */
+	/* Un-select modules */
 	ddrphy_dly_sel_write(0);
 
 #if defined(SDRAM_PHY_ECP5DDRPHY) || defined(SDRAM_PHY_GW2DDRPHY)
@@ -918,32 +992,49 @@ static void sdram_read_leveling_inc_delay(int module) {
 #endif
 }
 
-static void sdram_read_leveling_rst_bitslip(char m)
+static void sdram_read_leveling_rst_delay(int module) {
+	sdram_read_leveling_rst_delay_sel(1 << module);
+}
+
+__attribute__((unused)) static void sdram_read_leveling_inc_delay(int module) {
+	sdram_read_leveling_inc_delay_sel(1 << module);
+}
+
+static void sdram_read_leveling_rst_bitslip_sel(unsigned int sel)
 {
-	/* Select module */
-	ddrphy_dly_sel_write(1 << m);
+	/* Select modules */
+	ddrphy_dly_sel_write(sel);
 
 	/* Reset delay */
 	ddrphy_rdly_dq_bitslip_rst_write(1);
 
-	/* Un-select module */
+	/* Un-select modules */
 	ddrphy_dly_sel_write(0);
 }
 
-
-static void sdram_read_leveling_inc_bitslip(char m)
+static void sdram_read_leveling_inc_bitslip_sel(unsigned int sel)
 {
-	/* Select module */
-	ddrphy_dly_sel_write(1 << m);
+	/* Select modules */
+	ddrphy_dly_sel_write(sel);
 
 	/* Increment delay */
 	ddrphy_rdly_dq_bitslip_write(1);
 
-	/* Un-select module */
+	/* Un-select modules */
 	ddrphy_dly_sel_write(0);
 }
 
-static unsigned int sdram_read_leveling_scan_module(int module, int bitslip, int show)
+static void sdram_read_leveling_rst_bitslip(char m)
+{
+	sdram_read_leveling_rst_bitslip_sel(1 << m);
+}
+
+__attribute__((unused)) static void sdram_read_leveling_inc_bitslip(char m)
+{
+	sdram_read_leveling_inc_bitslip_sel(1 << m);
+}
+
+__attribute__((unused)) static unsigned int sdram_read_leveling_scan_module(int module, int bitslip, int show)
 {
 	const unsigned int max_errors = 2*READ_CHECK_TEST_PATTERN_MAX_ERRORS;
 	int i;
@@ -977,57 +1068,296 @@ static unsigned int sdram_read_leveling_scan_module(int module, int bitslip, int
 	return score;
 }
 
-#endif /* CSR_DDRPHY_BASE */
+/* Per-module results of a lock-step read leveling scan */
+struct sdram_read_leveling_scan {
+	unsigned int score;
+	int delay_min;
+	int delay_max;
+	int delay_start;  /* Start of the refined taps */
+	int delay_count;  /* Number of refined taps */
+	unsigned int coarse[(SDRAM_PHY_DELAYS/SDRAM_LEVELING_COARSE_STEP + 31)/32]; /* Working coarse taps */
+	unsigned short errors[SDRAM_LEVELING_SCAN_SHOW_TAPS];
+};
+
+static void sdram_read_leveling_print_window(struct sdram_read_leveling_scan *scan)
+{
+	if (scan->delay_min < 0)
+		printf("delays: -");
+	else
+		printf("delays: %02d+-%02d",
+			(scan->delay_min+scan->delay_max)/2 % SDRAM_PHY_DELAYS,
+			(scan->delay_max-scan->delay_min)/2);
+}
 
-#endif /* CSR_SDRAM_BASE */
+static void sdram_read_leveling_check_modules(unsigned int *errors)
+{
+	int module;
 
-#ifdef CSR_SDRAM_BASE
+	for(module=0; module<SDRAM_PHY_MODULES; module++)
+		errors[module] = 0;
+	sdram_write_read_check_test_pattern_modules(42, errors);
+	sdram_write_read_check_test_pattern_modules(84, errors);
+}
 
-#if defined(SDRAM_PHY_WRITE_LEVELING_CAPABLE) || defined(SDRAM_PHY_READ_LEVELING_CAPABLE)
+/* Refine the windows tap by tap: module delays start at their own delay_start and are then stepped
+   in lock-step, found[] gets the first of their delay_count taps with the searched state (working or
+   not) or -1. */
+static void sdram_read_leveling_refine_modules(struct sdram_read_leveling_scan *scans, int working, int *found)
+{
+	unsigned int errors[SDRAM_PHY_MODULES];
+	unsigned int sel;
+	int module;
+	int delay;
+	int count;
 
-void sdram_read_leveling(void)
+	count = 0;
+	for(module=0; module<SDRAM_PHY_MODULES; module++) {
+		found[module] = -1;
+		count = max(count, scans[module].delay_count);
+	}
+	if (count == 0)
+		return;
+
+	/* Set delays to the start of the refined taps */
+	sdram_read_leveling_rst_delay_sel(SDRAM_PHY_MODULES_SEL);
+	for(delay=0; delay<SDRAM_PHY_DELAYS; delay++) {
+		sel = 0;
+		for(module=0; module<SDRAM_PHY_MODULES; module++)
+			if (delay < scans[module].delay_start)
+				sel |= (1 << module);
+		if (sel == 0)
+			break;
+		sdram_read_leveling_inc_delay_sel(sel);
+	}
+
+	/* Check the refined taps, all modules at once */
+	for(delay=0; delay<count; delay++) {
+		sdram_read_leveling_check_modules(errors);
+		for(module=0; module<SDRAM_PHY_MODULES; module++) {
+			if ((found[module] < 0) && (delay < scans[module].delay_count) &&
+			    ((errors[module] == 0) == working))
+				found[module] = scans[module].delay_start + delay;
+		}
+		sdram_read_leveling_inc_delay_sel(SDRAM_PHY_MODULES_SEL);
+	}
+}
+
+static void sdram_read_leveling_scan_modules(struct sdram_read_leveling_scan *scans, int bitslip, int show)
 {
+	const unsigned int max_errors = 2*READ_CHECK_TEST_PATTERN_MAX_ERRORS;
+	unsigned int errors[SDRAM_PHY_MODULES];
+	struct sdram_read_leveling_scan *scan;
+	int found[SDRAM_PHY_MODULES];
 	int module;
-	int bitslip;
-	unsigned int score;
-	unsigned int best_score;
-	int best_bitslip;
+	int delay;
+	int step;
+	int working;
+	int i;
 
+	step = sdram_leveling_scan_step();
 	for(module=0; module<SDRAM_PHY_MODULES; module++) {
-		/* Scan possible read windows */
-		best_score = 0;
-		best_bitslip = 0;
-		sdram_read_leveling_rst_bitslip(module);
-		for(bitslip=0; bitslip<SDRAM_PHY_BITSLIPS; bitslip++) {
-			/* Compute score */
-			score = sdram_read_leveling_scan_module(module, bitslip, 1);
-			sdram_leveling_center_module(module, 1, 0,
-				sdram_read_leveling_rst_delay, sdram_read_leveling_inc_delay);
-			printf("\n");
-			if (score > best_score) {
-				best_bitslip = bitslip;
-				best_score = score;
+		scans[module].score     = 0;
+		scans[module].delay_min = -1;
+		scans[module].delay_max = -1;
+		for(i=0; i<sizeof(scans[module].coarse)/sizeof(unsigned int); i++)
+			scans[module].coarse[i] = 0;
+	}
+
+	/* Check test pattern for each (coarse) delay value, on all modules at once */
+	sdram_read_leveling_rst_delay_sel(SDRAM_PHY_MODULES_SEL);
+	for(delay=0; delay<SDRAM_PHY_DELAYS; delay+=step) {
+		sdram_read_leveling_check_modules(errors);
+		for(module=0; module<SDRAM_PHY_MODULES; module++) {
+			scan    = &scans[module];
+			working = errors[module] == 0;
+			/* Same score as sdram_read_leveling_scan_module (on the coarse taps) */
+			scan->score += (working * max_errors*SDRAM_PHY_DELAYS) + (max_errors - errors[module]);
+			/* Same window as sdram_leveling_center_module: smallest working delay, then first
+			   failing delay after the jump into the working zone */
+			if (scan->delay_min < 0) {
+				if (working)
+					scan->delay_min = delay;
+			} else if (scan->delay_max < 0) {
+				if (!working && (delay >= scan->delay_min + SDRAM_PHY_DELAY_JUMP))
+					scan->delay_max = delay;
 			}
-			/* Exit */
-			if (bitslip == SDRAM_PHY_BITSLIPS-1)
+			if (working && (step > 1))
+				scan->coarse[(delay/step)/32] |= 1U << ((delay/step)%32);
+			if (delay%SDRAM_LEVELING_SCAN_SHOW_STEP == 0)
+				scan->errors[delay/SDRAM_LEVELING_SCAN_SHOW_STEP] = errors[module];
+		}
+		for(i=0; i<step; i++)
+			sdram_read_leveling_inc_delay_sel(SDRAM_PHY_MODULES_SEL);
+	}
+
+	if (step > 1) {
+		/* Refine smallest working delays (in the coarse step before the first working tap) */
+		for(module=0; module<SDRAM_PHY_MODULES; module++) {
+			scan = &scans[module];
+			scan->delay_start = 0;
+			scan->delay_count = 0;
+			if (scan->delay_min > 0) {
+				scan->delay_start = max(scan->delay_min - step + 1, 0);
+				scan->delay_count = scan->delay_min - scan->delay_start;
+			}
+		}
+		sdram_read_leveling_refine_modules(scans, 1, found);
+		for(module=0; module<SDRAM_PHY_MODULES; module++)
+			if (found[module] >= 0)
+				scans[module].delay_min = found[module];
+
+		/* Refine largest working delays: first failing coarse tap after the jump into the working
+		   zone, refined in the coarse step before it */
+		for(module=0; module<SDRAM_PHY_MODULES; module++) {
+			scan = &scans[module];
+			scan->delay_start = 0;
+			scan->delay_count = 0;
+			scan->delay_max   = -1;
+			if (scan->delay_min < 0)
+				continue;
+			scan->delay_start = scan->delay_min + SDRAM_PHY_DELAY_JUMP;
+			for(delay=(scan->delay_start + step - 1) & ~(step-1); delay<SDRAM_PHY_DELAYS; delay+=step) {
+				if (!(scan->coarse[(delay/step)/32] & (1U << ((delay/step)%32)))) {
+					scan->delay_max = delay;
+					break;
+				}
+			}
+			if (scan->delay_max < 0)
+				scan->delay_max = SDRAM_PHY_DELAYS;
+			scan->delay_start = max(scan->delay_start, scan->delay_max - step + 1);
+			scan->delay_count = max(scan->delay_max - scan->delay_start, 0);
+		}
+		sdram_read_leveling_refine_modules(scans, 0, found);
+		for(module=0; module<SDRAM_PHY_MODULES; module++)
+			if (found[module] >= 0)
+				scans[module].delay_max = found[module];
+	}
+
+	for(module=0; module<SDRAM_PHY_MODULES; module++) {
+		if (scans[module].delay_min >= 0 && scans[module].delay_max < 0)
+			scans[module].delay_max = SDRAM_PHY_DELAYS;
+	}
+
+	if (show) {
+		for(module=0; module<SDRAM_PHY_MODULES; module++) {
+			printf("  m%d, b%02d: |", module, bitslip);
+			for(delay=0; delay<SDRAM_LEVELING_SCAN_SHOW_TAPS; delay++)
+				print_scan_errors(scans[module].errors[delay]);
+			printf("| ");
+			sdram_read_leveling_print_window(&scans[module]);
+			printf("\n");
+		}
+	}
+}
+
+static void sdram_read_leveling_set_delays(struct sdram_read_leveling_scan *scans)
+{
+	unsigned int errors[SDRAM_PHY_MODULES];
+	unsigned int pending;
+	unsigned int sel;
+	int module;
+	int delay;
+	int retries = 8; /* Do N configs/checks and give up if failing */
+
+	/* Only modules with a working window */
+	pending = 0;
+	for(module=0; module<SDRAM_PHY_MODULES; module++)
+		if (scans[module].delay_min >= 0)
+			pending |= (1 << module);
+
+	while (pending && (retries > 0)) {
+		/* Set delays to the middle of the windows, modules leave the selection once set */
+		sdram_read_leveling_rst_delay_sel(pending);
+		cdelay(100);
+		for(delay=0; delay<SDRAM_PHY_DELAYS; delay++) {
+			sel = 0;
+			for(module=0; module<SDRAM_PHY_MODULES; module++)
+				if ((pending & (1 << module)) &&
+				    (delay < (scans[module].delay_min+scans[module].delay_max)/2 % SDRAM_PHY_DELAYS))
+					sel |= (1 << module);
+			if (sel == 0)
 				break;
-			/* Increment bitslip */
-			sdram_read_leveling_inc_bitslip(module);
+			sdram_read_leveling_inc_delay_sel(sel);
+			cdelay(100);
 		}
 
-		/* Select best read window */
-		printf("  best: m%d, b%02d ", module, best_bitslip);
-		sdram_read_leveling_rst_bitslip(module);
-		for (bitslip=0; bitslip<best_bitslip; bitslip++)
-			sdram_read_leveling_inc_bitslip(module);
+		/* Check */
+		sdram_read_leveling_check_modules(errors);
+		for(module=0; module<SDRAM_PHY_MODULES; module++)
+			if (errors[module] == 0)
+				pending &= ~(1 << module);
+		retries--;
+	}
+}
 
-		/* Re-do leveling on best read window*/
-		sdram_leveling_center_module(module, 1, 0,
-			sdram_read_leveling_rst_delay, sdram_read_leveling_inc_delay);
-		printf("\n");
+static void sdram_read_leveling_modules(int show)
+{
+	struct sdram_read_leveling_scan scans[SDRAM_PHY_MODULES];
+	unsigned int best_scores[SDRAM_PHY_MODULES];
+	int best_bitslips[SDRAM_PHY_MODULES];
+	unsigned int sel;
+	int module;
+	int bitslip;
+
+	/* Scan possible read windows, all modules in lock-step */
+	for(module=0; module<SDRAM_PHY_MODULES; module++) {
+		best_scores[module]   = 0;
+		best_bitslips[module] = 0;
+	}
+	sdram_read_leveling_rst_bitslip_sel(SDRAM_PHY_MODULES_SEL);
+	for(bitslip=0; bitslip<SDRAM_PHY_BITSLIPS; bitslip++) {
+		/* Compute scores */
+		sdram_read_leveling_scan_modules(scans, bitslip, show);
+		for(module=0; module<SDRAM_PHY_MODULES; module++) {
+			if (scans[module].score > best_scores[module]) {
+				best_bitslips[module] = bitslip;
+				best_scores[module]   = scans[module].score;
+			}
+		}
+		/* Exit */
+		if (bitslip == SDRAM_PHY_BITSLIPS-1)
+			break;
+		/* Increment bitslip */
+		sdram_read_leveling_inc_bitslip_sel(SDRAM_PHY_MODULES_SEL);
+	}
+
+	/* Select best read windows */
+	sdram_read_leveling_rst_bitslip_sel(SDRAM_PHY_MODULES_SEL);
+	for(bitslip=0; bitslip<SDRAM_PHY_BITSLIPS; bitslip++) {
+		sel = 0;
+		for(module=0; module<SDRAM_PHY_MODULES; module++)
+			if (bitslip < best_bitslips[module])
+				sel |= (1 << module);
+		if (sel == 0)
+			break;
+		sdram_read_leveling_inc_bitslip_sel(sel);
+	}
+
+	/* Re-do leveling on best read windows */
+	sdram_read_leveling_scan_modules(scans, 0, 0);
+	sdram_read_leveling_set_delays(scans);
+	if (show) {
+		for(module=0; module<SDRAM_PHY_MODULES; module++) {
+			printf("  best: m%d, b%02d ", module, best_bitslips[module]);
+			sdram_read_leveling_print_window(&scans[module]);
+			printf("\n");
+		}
 	}
 }
 
+#endif /* CSR_DDRPHY_BASE */
+
+#endif /* CSR_SDRAM_BASE */
+
+#ifdef CSR_SDRAM_BASE
+
+#if defined(SDRAM_PHY_WRITE_LEVELING_CAPABLE) || defined(SDRAM_PHY_READ_LEVELING_CAPABLE)
+
+void sdram_read_leveling(void)
+{
+	sdram_read_leveling_modules(1);
+}
+
 /*-----------------------------------------------------------------------*/
 /* Write latency calibration                                             */
 /*-----------------------------------------------------------------------*/
@@ -1151,42 +1481,14 @@ static void sdram_write_dq_dqs_training_inc_delay(int module) {
 	ddrphy_dly_sel_write(0);
 }
 
-static void sdram_read_leveling_best_bitslip(int module)
-{
-	unsigned int score;
-	int bitslip;
-	int best_bitslip = 0;
-	unsigned int best_score = 0;
-
-	sdram_read_leveling_rst_bitslip(module);
-	for(bitslip=0; bitslip<SDRAM_PHY_BITSLIPS; bitslip++) {
-		score = sdram_read_leveling_scan_module(module, bitslip, 0);
-		sdram_leveling_center_module(module, 0, 0,
-			sdram_read_leveling_rst_delay, sdram_read_leveling_inc_delay);
-		if (score > best_score) {
-			best_bitslip = bitslip;
-			best_score = score;
-		}
-		if (bitslip == SDRAM_PHY_BITSLIPS-1)
-			break;
-		sdram_read_leveling_inc_bitslip(module);
-	}
-
-	/* Select best read window and re-center it */
-	sdram_read_leveling_rst_bitslip(module);
-	for (bitslip=0; bitslip<best_bitslip; bitslip++)
-		sdram_read_leveling_inc_bitslip(module);
-	sdram_leveling_center_module(module, 0, 0,
-		sdram_read_leveling_rst_delay, sdram_read_leveling_inc_delay);
-}
-
 static void sdram_write_dq_dqs_training(void)
 {
 	int module;
 
+	/* Find best read bitslips/delays (of all modules at once) */
+	sdram_read_leveling_modules(0);
+
 	for(module=0; module<SDRAM_PHY_MODULES; module++) {
-		/* Find best bitslip */
-		sdram_read_leveling_best_bitslip(module);
 		/* Center DQ-DQS window */
 		sdram_leveling_center_module(module, 1, 1,
 			sdram_write_dq_dqs_training_rst_delay, sdram_write_dq_dqs_training_inc_delay);
@@ -1289,6 +1591,16 @@ int sdram_init(void)
 #endif
 		return 0;
 	}
+#if defined(CSR_SDRAM_GENERATOR_BASE) && defined(CSR_SDRAM_CHECKER_BASE) && defined(SDRAM_TEST_BIST)
+	/* Full-size test with the BIST generator/checker (opt-in, long on large memories) */
+	if(sdram_bist_memtest(0, MAIN_RAM_SIZE) != 0) {
+#ifdef CSR_DDRCTRL_BASE
+		ddrctrl_init_error_write(1);
+		ddrctrl_init_done_write(1);
+#endif
+		return 0;
+	}
+#endif
 	memspeed((unsigned int *) MAIN_RAM_BASE, MEMTEST_DATA_SIZE, false, 0);
 #endif
 #ifdef CSR_DDRCTRL_BASE
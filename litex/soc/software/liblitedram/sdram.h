@@ -41,6 +41,7 @@ void sdram_read_leveling(void);
 /*-----------------------------------------------------------------------*/
 /* Leveling                                                              */
 /*-----------------------------------------------------------------------*/
+void sdram_leveling_set_full_scan(int full);
 int sdram_leveling(void);
 
 /*-----------------------------------------------------------------------*/
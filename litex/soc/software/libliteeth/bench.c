@@ -0,0 +1,335 @@
+// License: BSD
+
+#include <generated/csr.h>
+#include <generated/mem.h>
+#include <generated/soc.h>
+
+#if defined(CSR_ETHMAC_BASE) && defined(CSR_TIMER0_BASE)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libbase/console.h>
+
+#include <libliteeth/udp.h>
+#include <libliteeth/bench.h>
+#include <libliteeth/helpers.h>
+
+#define BENCH_PORT		6072
+#define BENCH_HEADER_LEN	32 /* Sequence + zeros, rewritten on each datagram. */
+#define BENCH_WIRE_OVERHEAD	(8 + 14 + 20 + 8 + 4 + 12) /* Preamble/Eth/IP/UDP/CRC/IFG */
+#define BENCH_TX_SERVICE	64 /* Datagrams between RX services (ARP) on TX flood. */
+
+/* Max payload: fitting in a 1500 bytes MTU (- IP/UDP headers), as larger (jumbo) frames are
+   dropped by standard NICs/switches, and in an Ethernet MAC slot. */
+#define BENCH_MTU_SIZE		(1500 - 20 - 8)
+#define BENCH_SLOT_SIZE		(ETHMAC_SLOT_SIZE - 64)
+#define BENCH_MAX_SIZE \
+	((BENCH_SLOT_SIZE < BENCH_MTU_SIZE) ? BENCH_SLOT_SIZE : BENCH_MTU_SIZE)
+#define BENCH_ECHO_TIMEOUT	(CONFIG_CLOCK_FREQUENCY/10)
+#define BENCH_P99_SAMPLES	64
+
+/* Timer: timer0 is used free-running, ticks are accumulated on 64-bit. */
+
+static uint32_t timer_last;
+static uint64_t timer_ticks;
+
+static void bench_timer_init(void)
+{
+	timer0_en_write(0);
+	timer0_reload_write(0xffffffff);
+	timer0_load_write(0xffffffff);
+	timer0_en_write(1);
+	timer0_update_value_write(1);
+	timer_last  = timer0_value_read();
+	timer_ticks = 0;
+}
+
+static uint64_t bench_timer_ticks(void)
+{
+	uint32_t now;
+
+	timer0_update_value_write(1);
+	now = timer0_value_read();
+	timer_ticks += (uint32_t)(timer_last - now);
+	timer_last   = now;
+	return timer_ticks;
+}
+
+static uint32_t compute_mbps(uint64_t bytes, uint64_t ticks)
+{
+	if (ticks == 0)
+		return 0;
+	return (bytes*8*(uint64_t)CONFIG_CLOCK_FREQUENCY)/(ticks*1000000);
+}
+
+static uint32_t compute_pps(uint64_t packets, uint64_t ticks)
+{
+	if (ticks == 0)
+		return 0;
+	return (packets*CONFIG_CLOCK_FREQUENCY)/ticks;
+}
+
+static uint32_t compute_us(uint64_t ticks)
+{
+	return (ticks*1000000)/(uint64_t)CONFIG_CLOCK_FREQUENCY;
+}
+
+static int check_size(unsigned int size)
+{
+	if ((size < 4) || (size > BENCH_MAX_SIZE)) {
+		printf("Size must be between 4 and %d bytes.\n", BENCH_MAX_SIZE);
+		return 0;
+	}
+	return 1;
+}
+
+/* TX flood: datagrams are zeros except the sequence number, so the payload checksum is only
+   updated incrementally. RX is still serviced (periodically and while rate limiting) to answer
+   the ARP requests of the peer. */
+void eth_bench_tx(uint32_t ip, uint16_t port, unsigned int size, unsigned int rate_mbps, unsigned int seconds)
+{
+	uint8_t *payload;
+	uint32_t seq;
+	uint64_t now;
+	uint64_t next;
+	uint64_t period;
+	uint64_t report;
+	uint64_t start;
+	uint64_t packets;
+	uint32_t n;
+
+	if (!check_size(size))
+		return;
+	if (!udp_arp_resolve(ip)) {
+		printf("ARP resolution failed.\n");
+		return;
+	}
+
+	/* Inter-datagram period for the requested rate (0: max). */
+	period = 0;
+	if (rate_mbps)
+		period = ((uint64_t)(size + BENCH_WIRE_OVERHEAD)*8*CONFIG_CLOCK_FREQUENCY)/((uint64_t)rate_mbps*1000000);
+
+	printf("Sending %d bytes datagrams to port %d, press any key to stop.\n", size, port);
+	printf("     PPS     MBPS     PACKETS\n");
+	bench_timer_init();
+	start   = 0;
+	report  = 0;
+	next    = 0;
+	packets = 0;
+	n       = 0;
+	for (seq=0;;seq++) {
+		/* Rate limiting */
+		if (period) {
+			while (bench_timer_ticks() < next)
+				udp_service();
+			next += period;
+		}
+		if ((seq & (BENCH_TX_SERVICE - 1)) == 0)
+			udp_service();
+
+		payload = udp_get_tx_buffer();
+		/* Zero full payload on first use of each TX slot, then only the header. */
+		memset(payload, 0, (seq < ETHMAC_TX_SLOTS) ? size : BENCH_HEADER_LEN);
+		put_be32(payload, seq);
+		udp_send_sum(BENCH_PORT, port, size, udp_checksum_update(0, 0, seq));
+		n++;
+
+		/* Report every second */
+		now = bench_timer_ticks();
+		if ((now - report) >= CONFIG_CLOCK_FREQUENCY) {
+			packets += n;
+			printf("%8ld %8ld %11ld\n",
+				(unsigned long) compute_pps(n, now - report),
+				(unsigned long) compute_mbps((uint64_t)n*size, now - report),
+				(unsigned long) packets);
+			n      = 0;
+			report = now;
+			if (readchar_nonblock())
+				break;
+			if (seconds && ((now - start) >= (uint64_t)seconds*CONFIG_CLOCK_FREQUENCY))
+				break;
+		}
+	}
+}
+
+/* RX sink: counts datagrams, bytes and drops (from the sequence numbers). */
+
+static uint16_t rx_port;
+static uint32_t rx_packets;
+static uint32_t rx_bytes;
+static uint32_t rx_drops;
+static uint32_t rx_expected;
+static int rx_started;
+
+static void rx_callback(uint32_t src_ip, uint16_t src_port, uint16_t dst_port, void *data, unsigned int length)
+{
+	uint32_t seq;
+
+	if (dst_port != rx_port) return;
+	rx_packets++;
+	rx_bytes += length;
+	if (length < 4)
+		return;
+	seq = get_be32(data);
+	/* Restarted sender: resynchronize. */
+	if (rx_started && ((int32_t)(seq - rx_expected) > 0))
+		rx_drops += seq - rx_expected;
+	rx_expected = seq + 1;
+	rx_started  = 1;
+}
+
+void eth_bench_rx(uint16_t port, unsigned int seconds)
+{
+	uint64_t now;
+	uint64_t report;
+	uint32_t packets, bytes, drops;
+	uint64_t total_packets = 0;
+	uint64_t total_drops   = 0;
+
+	rx_port     = port;
+	rx_packets  = 0;
+	rx_bytes    = 0;
+	rx_drops    = 0;
+	rx_started  = 0;
+	udp_set_callback(rx_callback);
+
+	printf("Receiving on port %d, press any key to stop.\n", port);
+	printf("     PPS     MBPS    DROPS     PACKETS\n");
+	bench_timer_init();
+	report = 0;
+	for (;;) {
+		udp_service();
+
+		/* Report every second */
+		now = bench_timer_ticks();
+		if ((now - report) >= CONFIG_CLOCK_FREQUENCY) {
+			packets = rx_packets;
+			bytes   = rx_bytes;
+			drops   = rx_drops;
+			rx_packets = 0;
+			rx_bytes   = 0;
+			rx_drops   = 0;
+			total_packets += packets;
+			total_drops   += drops;
+			printf("%8ld %8ld %8ld %11ld\n",
+				(unsigned long) compute_pps(packets, now - report),
+				(unsigned long) compute_mbps(bytes, now - report),
+				(unsigned long) drops,
+				(unsigned long) total_packets);
+			report = now;
+			if (readchar_nonblock())
+				break;
+			if (seconds && (now >= (uint64_t)seconds*CONFIG_CLOCK_FREQUENCY))
+				break;
+		}
+	}
+	udp_set_callback(NULL);
+	printf("Total: %ld packets, %ld drops.\n", (unsigned long) total_packets, (unsigned long) total_drops);
+}
+
+/* Echo: round-trip latency against a UDP echo server (ex RFC 862 port 7). */
+
+static uint32_t echo_ip;
+static uint32_t echo_seq;
+static int echo_received;
+
+static void echo_callback(uint32_t src_ip, uint16_t src_port, uint16_t dst_port, void *data, unsigned int length)
+{
+	if (dst_port != BENCH_PORT) return;
+	if (src_ip != echo_ip) return;
+	if (length < 4) return;
+	if (get_be32(data) == echo_seq)
+		echo_received = 1;
+}
+
+void eth_bench_echo(uint32_t ip, uint16_t port, unsigned int size, unsigned int count)
+{
+	uint8_t *payload;
+	uint64_t start;
+	uint64_t ticks;
+	uint64_t min_ticks = ~0ULL;
+	uint64_t max_ticks = 0;
+	uint64_t sum_ticks = 0;
+	uint64_t top[BENCH_P99_SAMPLES]; /* Largest samples (descending), for the 99th percentile. */
+	unsigned int ntop;
+	unsigned int p99_rank;
+	unsigned int pct;
+	char pct_label[16];
+	unsigned int received = 0;
+	unsigned int lost = 0;
+	unsigned int i, j;
+
+	if (!check_size(size))
+		return;
+	if (count == 0)
+		return;
+	if (!udp_arp_resolve(ip)) {
+		printf("ARP resolution failed.\n");
+		return;
+	}
+
+	/* The 99th percentile is the (count/100 + 1)th largest sample (only the BENCH_P99_SAMPLES
+	   largest are kept, the percentile actually computed is reported). */
+	p99_rank = count/100 + 1;
+	if (p99_rank > BENCH_P99_SAMPLES)
+		p99_rank = BENCH_P99_SAMPLES;
+	ntop = 0;
+
+	echo_ip = ip;
+	udp_set_callback(echo_callback);
+	printf("Echo of %d bytes datagrams on port %d (%d times)...\n", size, port, count);
+	bench_timer_init();
+	for (i=0; i<count; i++) {
+		if (readchar_nonblock())
+			break;
+		echo_seq      = i;
+		echo_received = 0;
+		payload = udp_get_tx_buffer();
+		memset(payload, 0, size);
+		put_be32(payload, i);
+		start = bench_timer_ticks();
+		udp_send(BENCH_PORT, port, size);
+		do {
+			udp_service();
+			ticks = bench_timer_ticks() - start;
+		} while (!echo_received && (ticks < BENCH_ECHO_TIMEOUT));
+		if (!echo_received) {
+			lost++;
+			continue;
+		}
+		received++;
+		sum_ticks += ticks;
+		if (ticks < min_ticks) min_ticks = ticks;
+		if (ticks > max_ticks) max_ticks = ticks;
+		/* Insert in the largest samples */
+		for (j=ntop; (j > 0) && (top[j-1] < ticks); j--)
+			if (j < p99_rank)
+				top[j] = top[j-1];
+		if (j < p99_rank) {
+			top[j] = ticks;
+			if (ntop < p99_rank)
+				ntop++;
+		}
+	}
+	udp_set_callback(NULL);
+
+	if (received == 0) {
+		printf("No echo received.\n");
+		return;
+	}
+	/* Percentile of the ntop-th largest received sample (in 0.1%). */
+	pct = (1000*(uint64_t)(received - ntop + 1))/received;
+	snprintf(pct_label, sizeof(pct_label), "P%d.%d(us)", pct/10, pct%10);
+	printf("     MIN(us)      AVG(us) %12s      MAX(us)     RECEIVED   LOST\n", pct_label);
+	printf("%12ld %12ld %12ld %12ld %12d %6d\n",
+		(unsigned long) compute_us(min_ticks),
+		(unsigned long) compute_us(sum_ticks/received),
+		(unsigned long) compute_us(top[ntop-1]),
+		(unsigned long) compute_us(max_ticks),
+		received, lost);
+}
+
+#endif
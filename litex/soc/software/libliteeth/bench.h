@@ -0,0 +1,11 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdint.h>
+
+/* Ethernet (UDP) benchmarks, datagrams start with a 32-bit big-endian sequence number. */
+void eth_bench_tx(uint32_t ip, uint16_t port, unsigned int size, unsigned int rate_mbps, unsigned int seconds);
+void eth_bench_rx(uint16_t port, unsigned int seconds);
+void eth_bench_echo(uint32_t ip, uint16_t port, unsigned int size, unsigned int count);
+
+#endif /* __BENCH_H */
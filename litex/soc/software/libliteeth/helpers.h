@@ -0,0 +1,58 @@
+#ifndef __LIBLITEETH_HELPERS_H
+#define __LIBLITEETH_HELPERS_H
+
+#include <stdint.h>
+
+#include <generated/csr.h>
+#include <generated/soc.h>
+
+/* Big-endian fields of the protocols headers (byte arrays, no alignment requirement). */
+
+static inline uint32_t get_be32(const uint8_t *data)
+{
+	return ((uint32_t) data[0] << 24) |
+	       ((uint32_t) data[1] << 16) |
+	       ((uint32_t) data[2] <<  8) |
+	        (uint32_t) data[3];
+}
+
+static inline void put_be32(uint8_t *data, uint32_t value)
+{
+	data[0] = value >> 24;
+	data[1] = value >> 16;
+	data[2] = value >>  8;
+	data[3] = value;
+}
+
+/* Retransmission/idle timeouts (timer0 when available, else iterations). */
+
+#ifdef CSR_TIMER0_BASE
+static inline void timer_start(unsigned int ms)
+{
+	timer0_en_write(0);
+	timer0_reload_write(0);
+	timer0_load_write(CONFIG_CLOCK_FREQUENCY/1000*ms);
+	timer0_en_write(1);
+	timer0_update_value_write(1);
+}
+
+static inline int timer_expired(void)
+{
+	timer0_update_value_write(1);
+	return timer0_value_read() == 0;
+}
+#else
+static unsigned int timer_count __attribute__((unused));
+
+static inline void timer_start(unsigned int ms)
+{
+	timer_count = 4000*ms;
+}
+
+static inline int timer_expired(void)
+{
+	return timer_count-- == 0;
+}
+#endif
+
+#endif /* __LIBLITEETH_HELPERS_H */
@@ -0,0 +1,265 @@
+// License: BSD
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <generated/csr.h>
+#include <generated/mem.h>
+#include <generated/soc.h>
+
+#include <libbase/crc.h>
+#include <libbase/progress.h>
+
+#include <libliteeth/udp.h>
+#include <libliteeth/mcast.h>
+#include <libliteeth/helpers.h>
+
+#ifdef CSR_ETHMAC_BASE
+
+/*
+ * Multicast image distribution: the server sends the image as a sequenced block stream to a
+ * multicast group, each board tracks the received blocks in a bitmap and, at the end of the
+ * stream, requests the missing ones by unicast (repairs). The boot time of a rack of boards is
+ * then roughly the time of a single transfer.
+ *
+ * Packets (all fields big-endian) start with a 20-byte header:
+ *   cmd (8-bit), reserved (8-bit), block_size (16-bit), block (32-bit), blocks (32-bit),
+ *   length (32-bit), crc (32-bit, CRC32 of the image).
+ * - DATA:   header + block data (server to group or board).
+ * - END:    header (server to group): end of the stream.
+ * - REPAIR: header + list of missing (block, count) ranges (board to server).
+ *
+ * The bitmap is stored in RAM right after the image (aligned).
+ */
+
+enum {
+	MCAST_DATA   = 1,
+	MCAST_END    = 2,
+	MCAST_REPAIR = 3,
+};
+
+#define MCAST_HEADER_LEN	20
+#define MCAST_REPAIR_RANGES	64
+
+/* Timeouts (ms) */
+#define MCAST_TIMEOUT		250
+#define MCAST_START_TRIES	80  /* Wait for the stream to start.                 */
+#define MCAST_IDLE_TRIES	4   /* No data received: end of stream.              */
+#define MCAST_REPAIR_TRIES	40  /* Repair requests without progress before abort. */
+
+struct mcast_header {
+	uint8_t cmd;
+	uint8_t reserved;
+	uint8_t block_size[2];
+	uint8_t block[4];
+	uint8_t blocks[4];
+	uint8_t length[4];
+	uint8_t crc[4];
+} __attribute__((packed));
+
+static uint8_t *dst_buffer;
+static unsigned long dst_size;
+static uint32_t *bitmap;
+static int started;
+static int ended;
+static int oversized;
+static int activity;
+static uint16_t data_port;
+static uint32_t server_ip;
+static uint16_t server_port;
+static uint32_t block_size;
+static uint32_t blocks;
+static uint32_t received;
+static uint32_t length;
+static uint32_t crc;
+
+static void rx_callback(uint32_t src_ip, uint16_t src_port,
+    uint16_t dst_port, void *_data, unsigned int len)
+{
+	const struct mcast_header *h = _data;
+	uint32_t block;
+
+	if(dst_port != data_port) return;
+	if(len < MCAST_HEADER_LEN) return;
+	len -= MCAST_HEADER_LEN;
+
+	/* Start of session: the first packet gives the image geometry, that must be consistent and
+	   fit (with the bitmap) in the buffer. */
+	if(!started) {
+		uint64_t bitmap_offset;
+		block_size  = (h->block_size[0] << 8) | h->block_size[1];
+		blocks      = get_be32(h->blocks);
+		length      = get_be32(h->length);
+		crc         = get_be32(h->crc);
+		if((block_size == 0) || (length == 0) ||
+		   (blocks != ((uint64_t)length + block_size - 1)/block_size))
+			return;
+		bitmap_offset = (((uintptr_t)dst_buffer + (uint64_t)length + 3) & ~3ULL) - (uintptr_t)dst_buffer;
+		if(bitmap_offset + 4*(((uint64_t)blocks + 31)/32) > dst_size) {
+			oversized = 1;
+			return;
+		}
+		server_ip   = src_ip;
+		server_port = src_port;
+		bitmap      = (uint32_t *)(((uintptr_t)dst_buffer + length + 3) & ~3);
+		memset(bitmap, 0, 4*((blocks + 31)/32));
+		received    = 0;
+		started     = 1;
+		printf("Receiving %ld bytes (%ld blocks)...\n", (unsigned long) length, (unsigned long) blocks);
+	}
+	/* Ignore other sessions. */
+	if((src_ip != server_ip) || (get_be32(h->crc) != crc) || (get_be32(h->length) != length))
+		return;
+
+	if(h->cmd == MCAST_END) {
+		ended = 1;
+		return;
+	}
+	if(h->cmd != MCAST_DATA)
+		return;
+	block = get_be32(h->block);
+	if(block >= blocks)
+		return;
+	if(bitmap[block/32] & (1UL << (block%32)))
+		return;
+	if(len != ((block == blocks - 1) ? length - block*block_size : block_size))
+		return;
+	memcpy(dst_buffer + block*block_size, (const uint8_t *)_data + MCAST_HEADER_LEN, len);
+	bitmap[block/32] |= 1UL << (block%32);
+	received++;
+	activity = 1;
+	if((received % 64) == 0)
+		show_progress(-1);
+}
+
+/* Request up to MCAST_REPAIR_RANGES ranges of missing blocks. */
+static void send_repair(void)
+{
+	struct mcast_header *h;
+	uint8_t *ranges;
+	uint32_t block;
+	uint32_t start;
+	int n;
+
+	h = udp_get_tx_buffer();
+	memset(h, 0, sizeof(*h));
+	h->cmd = MCAST_REPAIR;
+	put_be32(h->blocks, blocks);
+	put_be32(h->length, length);
+	put_be32(h->crc,    crc);
+	ranges = (uint8_t *)h + MCAST_HEADER_LEN;
+
+	n = 0;
+	block = 0;
+	while((block < blocks) && (n < MCAST_REPAIR_RANGES)) {
+		if(bitmap[block/32] & (1UL << (block%32))) {
+			block++;
+			continue;
+		}
+		start = block;
+		while((block < blocks) && !(bitmap[block/32] & (1UL << (block%32))))
+			block++;
+		put_be32(ranges + 8*n + 0, start);
+		put_be32(ranges + 8*n + 4, block - start);
+		n++;
+	}
+	udp_send(data_port, server_port, MCAST_HEADER_LEN + 8*n);
+}
+
+int mcast_get(uint32_t group, uint16_t port, void *buffer, unsigned long max_size)
+{
+	int tries;
+	int resolved;
+	int progress;
+
+	dst_buffer = buffer;
+	dst_size   = max_size;
+	data_port  = port;
+	started    = 0;
+	ended      = 0;
+	oversized  = 0;
+	resolved   = 0;
+
+	udp_set_callback(rx_callback);
+	udp_join_multicast(group);
+
+	/* Receive the stream. */
+	init_progression_bar(0);
+	tries = MCAST_START_TRIES;
+	timer_start(MCAST_TIMEOUT);
+	while(!started || (received < blocks)) {
+		activity = 0;
+		udp_service();
+		if(activity) {
+			tries = MCAST_IDLE_TRIES;
+			timer_start(MCAST_TIMEOUT);
+			continue;
+		}
+		if(ended || oversized)
+			break;
+		if(timer_expired()) {
+			if(--tries == 0)
+				break;
+			/* Refresh membership (IGMP snooping switches) while waiting for the stream. */
+			if(!started)
+				udp_join_multicast(group);
+			timer_start(MCAST_TIMEOUT);
+		}
+	}
+	if(oversized) {
+		printf("Image too large (%ld bytes, %ld bytes available).\n",
+			(unsigned long) length, max_size);
+		goto fail;
+	}
+	if(!started) {
+		printf("No multicast stream.\n");
+		goto fail;
+	}
+
+	/* Request the missing blocks. */
+	tries = MCAST_REPAIR_TRIES;
+	while(received < blocks) {
+		if(!resolved) {
+			if(!udp_arp_resolve(server_ip))
+				goto fail;
+			resolved = 1;
+		}
+		send_repair();
+		/* Back off while the repaired blocks are arriving (serving a large repair can take longer
+		   than the timeout): a new request is only sent when no block has been received for
+		   MCAST_TIMEOUT. */
+		progress = 0;
+		timer_start(MCAST_TIMEOUT);
+		while(!timer_expired() && (received < blocks)) {
+			activity = 0;
+			udp_service();
+			if(activity) {
+				progress = 1;
+				timer_start(MCAST_TIMEOUT);
+			}
+		}
+		if(progress)
+			tries = MCAST_REPAIR_TRIES;
+		else if(--tries == 0) {
+			printf("Repair failed (%ld/%ld blocks).\n", (unsigned long) received, (unsigned long) blocks);
+			goto fail;
+		}
+	}
+
+	udp_join_multicast(0);
+	udp_set_callback(NULL);
+
+	if(crc32(dst_buffer, length) != crc) {
+		printf("CRC error.\n");
+		return -1;
+	}
+	return length;
+
+fail:
+	udp_join_multicast(0);
+	udp_set_callback(NULL);
+	return -1;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef __MCAST_H
+#define __MCAST_H
+
+#include <stdint.h>
+
+/* Multicast image distribution (see litex/tools/litex_mcast_server.py). */
+
+#define MCAST_PORT	6071
+#define MCAST_GROUP	((239 << 24)|(255 << 16)|(76 << 8)|88) /* 239.255.76.88 */
+
+/* Receive an image to buffer (max_size bytes, image + reception bitmap), returns its length or
+   -1 on error. */
+int mcast_get(uint32_t group, uint16_t port, void *buffer, unsigned long max_size);
+
+#endif /* __MCAST_H */
@@ -8,12 +8,20 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <generated/csr.h>
+#include <generated/mem.h>
+#include <generated/soc.h>
+
 #include <libbase/progress.h>
 
 #include <libliteeth/udp.h>
 #include <libliteeth/tftp.h>
+#include <libliteeth/helpers.h>
+
+#ifdef CSR_ETHMAC_BASE
 
 /* Local TFTP client port (arbitrary) */
 #define PORT_IN		7642
@@ -27,41 +35,56 @@ enum {
 	TFTP_OACK	= 6,	/* Option Acknowledgment */
 };
 
-#define	BLOCK_SIZE	1024 /* block size in bytes 512 or 1024*/
+/* Default block size (without blksize option) */
+#define DEFAULT_BLOCK_SIZE	512
+
+/* Requested block size (RFC 2348): largest block fitting in a 1500 bytes MTU (- IP/UDP/TFTP
+   headers) and in an Ethernet MAC slot (- Preamble/Ethernet/IP/UDP/TFTP headers and CRC). */
+#ifndef TFTP_BLOCK_SIZE
+#define TFTP_MTU_BLOCK_SIZE	(1500 - 20 - 8 - 4)
+#define TFTP_SLOT_BLOCK_SIZE	(ETHMAC_SLOT_SIZE - 8 - 14 - 20 - 8 - 4 - 4)
+#define TFTP_BLOCK_SIZE \
+	((TFTP_SLOT_BLOCK_SIZE < TFTP_MTU_BLOCK_SIZE) ? TFTP_SLOT_BLOCK_SIZE : TFTP_MTU_BLOCK_SIZE)
+#endif
+
+/* Requested window size (RFC 7440): the server sends a window of blocks before waiting for an
+   ACK, limit it to the number of Ethernet MAC RX slots to avoid losing blocks of a window. */
+#ifndef TFTP_WINDOW_SIZE
+#define TFTP_WINDOW_SIZE	ETHMAC_RX_SLOTS
+#endif
+
+/* Retransmission timeout (ms) and number of retries. */
+#define TFTP_TIMEOUT		500
+#define TFTP_TRIES		10
+
+static int format_option(uint8_t *buf, const char *name, int value)
+{
+	char str[8];
+	int len;
+
+	len = strlen(name) + 1;
+	memcpy(buf, name, len);
+	sprintf(str, "%d", value);
+	memcpy(buf + len, str, strlen(str) + 1);
+	return len + strlen(str) + 1;
+}
 
 static int format_request(uint8_t *buf, uint16_t op, const char *filename)
 {
 	int len = strlen(filename);
+	uint8_t *start = buf;
 
 	*buf++ = op >> 8; /* Opcode */
 	*buf++ = op;
 	memcpy(buf, filename, len);
 	buf += len;
 	*buf++ = 0x00;
-	*buf++ = 'o';
-	*buf++ = 'c';
-	*buf++ = 't';
-	*buf++ = 'e';
-	*buf++ = 't';
-	*buf++ = 0x00;
-#if (BLOCK_SIZE == 1024)
-	*buf++ = 'b';
-	*buf++ = 'l';
-	*buf++ = 'k';
-	*buf++ = 's';
-	*buf++ = 'i';
-	*buf++ = 'z';
-	*buf++ = 'e';
-	*buf++ = 0x00;
-	*buf++ = '1';
-	*buf++ = '0';
-	*buf++ = '2';
-	*buf++ = '4';
-	*buf++ = 0x00;
-	return 9 + 13 + strlen(filename);
-#else
-	return 9 + strlen(filename);
-#endif
+	memcpy(buf, "octet", 6);
+	buf += 6;
+	buf += format_option(buf, "blksize", TFTP_BLOCK_SIZE);
+	if (op == TFTP_RRQ)
+		buf += format_option(buf, "windowsize", TFTP_WINDOW_SIZE);
+	return buf - start;
 }
 
 static int format_ack(uint8_t *buf, uint16_t block)
@@ -83,12 +106,47 @@ static int format_data(uint8_t *buf, uint16_t block, const void *data, int len)
 	return len+4;
 }
 
+/* Parse the options acknowledged by the server (OACK). */
+static void parse_oack(const uint8_t *data, unsigned int length, int *block_size, int *window_size)
+{
+	const char *name;
+	const char *value;
+	const char *end = (const char *) data + length;
+
+	name = (const char *) data;
+	while (name < end) {
+		value = name + strnlen(name, end - name) + 1;
+		if (value >= end)
+			break;
+		if (strcmp(name, "blksize") == 0)
+			*block_size = atoi(value);
+		if (strcmp(name, "windowsize") == 0)
+			*window_size = atoi(value);
+		name = value + strnlen(value, end - value) + 1;
+	}
+}
+
 static uint8_t *packet_data;
 static int total_length;
 static int transfer_finished;
 static uint8_t *dst_buffer;
 static int last_ack; /* signed, so we can use -1 */
 static uint16_t data_port;
+static int block_size;
+static int window_size;
+static unsigned int blocks;   /* Number of blocks received in order. */
+static int window_count;      /* Number of blocks received since last ACK. */
+static int started;           /* OACK/DATA received from the server. */
+static int activity;          /* Progress since last check. */
+static int recovering;        /* Out of order block already ACKed. */
+
+static void send_ack(uint16_t block)
+{
+	int length;
+	packet_data = udp_get_tx_buffer();
+	length = format_ack(packet_data, block);
+	udp_send(PORT_IN, data_port, length);
+}
 
 static void rx_callback(uint32_t src_ip, uint16_t src_port,
     uint16_t dst_port, void *_data, unsigned int length)
@@ -96,8 +154,6 @@ static void rx_callback(uint32_t src_ip, uint16_t src_port,
 	uint8_t *data = _data;
 	uint16_t opcode;
 	uint16_t block;
-	int i;
-	int offset;
 
 	if(length < 4) return;
 	if(dst_port != PORT_IN) return;
@@ -109,24 +165,65 @@ static void rx_callback(uint32_t src_ip, uint16_t src_port,
 		return;
 	}
 	if (opcode == TFTP_OACK) { /* Option Acknowledgement */
-		packet_data = udp_get_tx_buffer();
-		length = format_ack(packet_data, 0);
-		udp_send(PORT_IN, src_port, length);
+		/* Duplicate OACK (request retransmitted): ignore once data has been received. */
+		if (dst_buffer && (blocks > 0)) return;
+		data_port = src_port;
+		block_size  = DEFAULT_BLOCK_SIZE;
+		window_size = 1;
+		parse_oack(data + 2, length - 2, &block_size, &window_size);
+		if ((block_size < 8) || (block_size > TFTP_BLOCK_SIZE)) {
+			total_length = -1;
+			transfer_finished = 1;
+			return;
+		}
+		if (window_size < 1)
+			window_size = 1;
+		if (dst_buffer) {
+			/* Read: Acknowledge options, the server then starts sending data. */
+			started  = 1;
+			activity = 1;
+			send_ack(0);
+		} else {
+			/* Write: Options acknowledgement replaces ACK of block 0. */
+			last_ack = 0;
+		}
 		return;
 	}
-	if(block < 1) return;
 	if(opcode == TFTP_DATA) { /* Data */
+		if (!dst_buffer) return;
+		data_port = src_port;
+		/* No OACK: options not supported by the server. */
+		if (!started) {
+			started     = 1;
+			block_size  = DEFAULT_BLOCK_SIZE;
+			window_size = 1;
+		}
 		length -= 4;
-		offset = (block-1)*BLOCK_SIZE;
-		for(i=0;i<length;i++)
-			dst_buffer[offset+i] = data[i+4];
+		if ((int)length > block_size) return;
+		if (block != (uint16_t)(blocks + 1)) {
+			/* Lost/Out of order block: ACK the last block received in order once, the server
+			   then restarts the window from the next one (RFC 7440). */
+			if (!recovering) {
+				recovering   = 1;
+				window_count = 0;
+				send_ack(blocks);
+			}
+			return;
+		}
+		/* Zero-copy receive: data already in place (except for the first block). */
+		if (data + 4 != dst_buffer + blocks*block_size)
+			memmove(dst_buffer + blocks*block_size, data + 4, length);
+		blocks++;
 		total_length += length;
-		if(length < BLOCK_SIZE)
+		recovering = 0;
+		activity   = 1;
+		window_count++;
+		if((int)length < block_size)
 			transfer_finished = 1;
-
-		packet_data = udp_get_tx_buffer();
-		length = format_ack(packet_data, block);
-		udp_send(PORT_IN, src_port, length);
+		if (transfer_finished || (window_count >= window_size)) {
+			window_count = 0;
+			send_ack(block);
+		}
 	}
 	if(opcode == TFTP_ERROR) { /* Error */
 		total_length = -1;
@@ -134,13 +231,38 @@ static void rx_callback(uint32_t src_ip, uint16_t src_port,
 	}
 }
 
+/* Zero-copy receive (tftp_get): datagrams are received in the destination buffer where the data
+   of the next block goes, their TFTP header overwriting the last 4 bytes of the previous block
+   (saved, and restored once the datagram has been handled). The first block is received at the
+   start of the buffer and moved. The area after the received data is used as scratch. */
+#define TFTP_RX_SIZE	(~0U >> 1) /* Destination size is not known. */
+
+static unsigned int rx_offset;
+static uint8_t rx_saved[4];
+
+static void rx_set_offset(void)
+{
+	rx_offset = blocks ? blocks*block_size - 4 : 0;
+	if (rx_offset)
+		memcpy(rx_saved, dst_buffer + rx_offset, 4);
+	udp_set_rx_offset(PORT_IN, rx_offset);
+}
+
+static void rx_notify(uint32_t src_ip, uint16_t src_port, uint16_t dst_port,
+    unsigned int offset, unsigned int length)
+{
+	rx_callback(src_ip, src_port, dst_port, dst_buffer + offset, length);
+	if (rx_offset)
+		memcpy(dst_buffer + rx_offset, rx_saved, 4);
+	rx_set_offset();
+}
+
 int tftp_get(uint32_t ip, uint16_t server_port, const char *filename,
     void *buffer)
 {
 	int len;
 	int tries;
-	int i;
-	int length_before;
+	int progress;
 
 	if(!udp_arp_resolve(ip))
 		return -1;
@@ -151,40 +273,61 @@ int tftp_get(uint32_t ip, uint16_t server_port, const char *filename,
 
 	total_length = 0;
 	transfer_finished = 0;
-	tries = 5;
-	while(1) {
-		packet_data = udp_get_tx_buffer();
-		len = format_request(packet_data, TFTP_RRQ, filename);
-		udp_send(PORT_IN, server_port, len);
-		for(i=0;i<2000000;i++) {
-			udp_service();
-			if((total_length > 0) || transfer_finished) break;
-		}
-		if((total_length > 0) || transfer_finished) break;
-		tries--;
-		if(tries == 0) {
-			udp_set_callback(NULL);
-			return -1;
-		}
-	}
+	blocks = 0;
+	window_count = 0;
+	started = 0;
+	recovering = 0;
+	data_port = server_port;
+	block_size = DEFAULT_BLOCK_SIZE;
+	window_size = 1;
+
+	/* Zero-copy receive when a flow is available, else copied from rx_callback */
+	rx_offset = 0;
+	if (udp_set_rx_buffer(PORT_IN, buffer, TFTP_RX_SIZE, rx_notify))
+		rx_set_offset();
+
+	/* Send request */
+	packet_data = udp_get_tx_buffer();
+	len = format_request(packet_data, TFTP_RRQ, filename);
+	udp_send(PORT_IN, server_port, len);
 
-	i = 12000000;
-	length_before = total_length;
+	tries = TFTP_TRIES;
+	progress = 0;
 	init_progression_bar(0);
+	timer_start(TFTP_TIMEOUT);
 	while(!transfer_finished) {
-		if(length_before != total_length) {
-			i = 12000000;
-			length_before = total_length;
-			if ((total_length & (0x8000 - 1)) == 0)
+		activity = 0;
+		udp_service();
+		if(activity) {
+			tries = TFTP_TRIES;
+			timer_start(TFTP_TIMEOUT);
+			if (total_length - progress >= 0x8000) {
+				progress = total_length;
 				show_progress(-1);
+			}
+			continue;
 		}
-		if(i-- == 0) {
-			udp_set_callback(NULL);
-			return -1;
+		if(timer_expired()) {
+			if(--tries == 0) {
+				udp_set_rx_buffer(PORT_IN, NULL, 0, NULL);
+				udp_set_callback(NULL);
+				return -1;
+			}
+			/* Retransmit request (nothing received yet) or ACK of last block received in order */
+			if(!started) {
+				packet_data = udp_get_tx_buffer();
+				len = format_request(packet_data, TFTP_RRQ, filename);
+				udp_send(PORT_IN, server_port, len);
+			} else {
+				window_count = 0;
+				recovering   = 0;
+				send_ack(blocks);
+			}
+			timer_start(TFTP_TIMEOUT);
 		}
-		udp_service();
 	}
 
+	udp_set_rx_buffer(PORT_IN, NULL, 0, NULL);
 	udp_set_callback(NULL);
 
 	return total_length;
@@ -195,7 +338,6 @@ int tftp_put(uint32_t ip, uint16_t server_port, const char *filename,
 {
 	int len, send;
 	int tries;
-	int i;
 	int block = 0, sent = 0;
 
 	if(!udp_arp_resolve(ip))
@@ -203,17 +345,19 @@ int tftp_put(uint32_t ip, uint16_t server_port, const char *filename,
 
 	udp_set_callback(rx_callback);
 
-	packet_data = udp_get_tx_buffer();
+	dst_buffer = NULL;
 
 	total_length = 0;
 	transfer_finished = 0;
-	tries = 5;
+	block_size = DEFAULT_BLOCK_SIZE;
+	tries = TFTP_TRIES;
 	while(1) {
 		packet_data = udp_get_tx_buffer();
 		len = format_request(packet_data, TFTP_WRQ, filename);
 		udp_send(PORT_IN, server_port, len);
-		for(i=0;i<2000000;i++) {
-			last_ack = -1;
+		last_ack = -1;
+		timer_start(TFTP_TIMEOUT);
+		while(!timer_expired()) {
 			udp_service();
 			if(last_ack == block)
 				goto send_data;
@@ -228,17 +372,18 @@ int tftp_put(uint32_t ip, uint16_t server_port, const char *filename,
 send_data:
 	do {
 		block++;
-		send = sent+BLOCK_SIZE > size ? size-sent : BLOCK_SIZE;
-		tries = 5;
+		send = sent+block_size > size ? size-sent : block_size;
+		tries = TFTP_TRIES;
 		while(1) {
 			packet_data = udp_get_tx_buffer();
 			len = format_data(packet_data, block, buffer, send);
 			udp_send(PORT_IN, data_port, len);
-			for(i=0;i<12000000;i++) {
+			timer_start(TFTP_TIMEOUT);
+			while(!timer_expired()) {
 				udp_service();
 				if(transfer_finished)
 					goto fail;
-				if(last_ack == block)
+				if(last_ack == (uint16_t) block)
 					goto next;
 			}
 			if (!--tries)
@@ -247,7 +392,7 @@ send_data:
 next:
 		sent += send;
 		buffer += send;
-	} while (send == BLOCK_SIZE);
+	} while (send == block_size);
 
 	udp_set_callback(NULL);
 
@@ -257,3 +402,5 @@ fail:
 	udp_set_callback(NULL);
 	return -1;
 }
+
+#endif
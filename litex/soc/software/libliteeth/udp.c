@@ -12,6 +12,8 @@
 #ifdef CSR_ETHMAC_BASE
 
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <system.h>
 
@@ -131,11 +133,27 @@ static unsigned int txslot;
 static unsigned int txlen;
 static ethernet_buffer *txbuffer;
 
-static void send_packet(void)
+/* TX slots are used in round-robin and the MAC transmits them in order: the next slot is only
+   free once fewer than ETHMAC_TX_SLOTS frames are outstanding. Frames are queued without waiting
+   for the previous ones, so up to ETHMAC_TX_SLOTS frames can be sent back-to-back. */
+static unsigned int tx_outstanding(void)
 {
-	/* wait buffer to be available */
-	while(!(ethmac_sram_reader_ready_read()));
+#ifdef CSR_ETHMAC_SRAM_READER_LEVEL_ADDR
+	return ethmac_sram_reader_level_read();
+#else
+	return ethmac_sram_reader_ready_read() ? 0 : ETHMAC_TX_SLOTS;
+#endif
+}
+
+static ethernet_buffer *tx_get_buffer(void)
+{
+	/* wait current slot to be available */
+	while(tx_outstanding() >= ETHMAC_TX_SLOTS);
+	return txbuffer;
+}
 
+static void send_packet(void)
+{
 	/* fill txbuffer */
 #ifndef HW_PREAMBLE_CRC
 	unsigned int crc;
@@ -155,7 +173,8 @@ static void send_packet(void)
 	printf("\n");
 #endif
 
-	/* fill slot, length and send */
+	/* fill slot, length and send (the MAC queues up to ETHMAC_TX_SLOTS commands) */
+	while(!(ethmac_sram_reader_ready_read()));
 	ethmac_sram_reader_slot_write(txslot);
 	ethmac_sram_reader_length_write(txlen);
 	ethmac_sram_reader_start_write(1);
@@ -207,6 +226,7 @@ static void process_arp(void)
 		if(ntohl(rx_arp->target_ip) == my_ip) {
 			int i;
 
+			tx_arp = &tx_get_buffer()->frame.contents.arp;
 			fill_eth_header(&txbuffer->frame.eth_header,
 				rx_arp->sender_mac,
 				my_mac,
@@ -248,6 +268,7 @@ int udp_arp_resolve(unsigned int ip)
 
 	for(tries=0;tries<100;tries++) {
 		/* Send an ARP request */
+		tx_get_buffer();
 		fill_eth_header(&txbuffer->frame.eth_header,
 				broadcast,
 				my_mac,
@@ -279,16 +300,71 @@ int udp_arp_resolve(unsigned int ip)
 	return 0;
 }
 
-static unsigned short ip_checksum(unsigned int r, void *buffer, unsigned int length, int complete)
+/* 16/32-bit accesses of the checksummed buffers (headers/payloads written through other types). */
+typedef uint16_t __attribute__((__may_alias__)) sum_half_t;
+typedef uint32_t __attribute__((__may_alias__)) sum_word_t;
+
+/* One's complement sum of a buffer, in memory order (RFC 1071: the sum is byte order
+   independent, so it is converted to network order only once). 32-bit words are summed in a
+   64-bit accumulator, carries are added back at the end. */
+static uint32_t ip_sum(const void *buffer, unsigned int length)
 {
-	unsigned char *ptr;
-	unsigned int i;
+	const uint8_t *ptr = buffer;
+	uint64_t sum = 0;
+	uint16_t h;
+
+	if((uintptr_t)ptr & 1) {
+		/* Unaligned buffer: byte loads. */
+		while(length >= 2) {
+			memcpy(&h, ptr, 2);
+			sum += h;
+			ptr += 2;
+			length -= 2;
+		}
+	} else {
+		if(((uintptr_t)ptr & 2) && (length >= 2)) {
+			sum += *(const sum_half_t *)ptr;
+			ptr += 2;
+			length -= 2;
+		}
+		while(length >= 16) {
+			sum += ((const sum_word_t *)ptr)[0];
+			sum += ((const sum_word_t *)ptr)[1];
+			sum += ((const sum_word_t *)ptr)[2];
+			sum += ((const sum_word_t *)ptr)[3];
+			ptr += 16;
+			length -= 16;
+		}
+		while(length >= 4) {
+			sum += *(const sum_word_t *)ptr;
+			ptr += 4;
+			length -= 4;
+		}
+		if(length >= 2) {
+			sum += *(const sum_half_t *)ptr;
+			ptr += 2;
+			length -= 2;
+		}
+	}
+	/* Odd length: pad last byte with zero. */
+	if(length) {
+		h = 0;
+		*(uint8_t *)&h = *ptr;
+		sum += h;
+	}
 
-	ptr = (unsigned char *)buffer;
-	length >>= 1;
+	/* Add overflows */
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
 
-	for(i=0;i<length;i++)
-		r += ((unsigned int)(ptr[2*i]) << 8)|(unsigned int)(ptr[2*i+1]) ;
+static unsigned short ip_checksum(unsigned int r, const void *buffer, unsigned int length, int complete)
+{
+	r += ntohs(ip_sum(buffer, length));
 
 	/* Add overflows */
 	while(r >> 16)
@@ -302,9 +378,28 @@ static unsigned short ip_checksum(unsigned int r, void *buffer, unsigned int len
 	return r;
 }
 
+unsigned int udp_checksum_partial(const void *data, unsigned int length)
+{
+	return ip_checksum(0, data, length, 0);
+}
+
+unsigned int udp_checksum_update(unsigned int sum, unsigned int old_value, unsigned int new_value)
+{
+	/* RFC 1624: HC' = ~(~HC + ~m + m'), on the partial (non complemented) sum. */
+	sum += (~old_value >> 16) & 0xffff;
+	sum += (~old_value) & 0xffff;
+	sum += (new_value >> 16) & 0xffff;
+	sum += (new_value) & 0xffff;
+
+	/* Add overflows */
+	while(sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
+
 void *udp_get_tx_buffer(void)
 {
-	return txbuffer->frame.contents.udp.payload;
+	return tx_get_buffer()->frame.contents.udp.payload;
 }
 
 struct pseudo_header {
@@ -315,7 +410,8 @@ struct pseudo_header {
 	unsigned short length;
 } __attribute__((packed));
 
-int udp_send(unsigned short src_port, unsigned short dst_port, unsigned int length)
+static int udp_send_frame(unsigned short src_port, unsigned short dst_port, unsigned int length,
+	const unsigned int *payload_sum)
 {
 	struct pseudo_header h;
 	unsigned int r;
@@ -352,12 +448,14 @@ int udp_send(unsigned short src_port, unsigned short dst_port, unsigned int leng
 
 	h.zero = 0;
 	r = ip_checksum(0, &h, sizeof(struct pseudo_header), 0);
-	if(length & 1) {
-		txbuffer->frame.contents.udp.payload[length] = 0;
-		length++;
+	if(payload_sum) {
+		/* Payload sum provided by the caller: only sum the headers. */
+		r = ip_checksum(r + *payload_sum, &txbuffer->frame.contents.udp.udp,
+			sizeof(struct udp_header), 1);
+	} else {
+		r = ip_checksum(r, &txbuffer->frame.contents.udp.udp,
+			sizeof(struct udp_header)+length, 1);
 	}
-	r = ip_checksum(r, &txbuffer->frame.contents.udp.udp,
-		sizeof(struct udp_header)+length, 1);
 	txbuffer->frame.contents.udp.udp.checksum = htons(r);
 
 	send_packet();
@@ -365,13 +463,285 @@ int udp_send(unsigned short src_port, unsigned short dst_port, unsigned int leng
 	return 1;
 }
 
+int udp_send(unsigned short src_port, unsigned short dst_port, unsigned int length)
+{
+	return udp_send_frame(src_port, dst_port, length, NULL);
+}
+
+int udp_send_sum(unsigned short src_port, unsigned short dst_port, unsigned int length, unsigned int payload_sum)
+{
+	return udp_send_frame(src_port, dst_port, length, &payload_sum);
+}
+
+/* Multicast (IGMP-lite): one group can be joined, datagrams sent to it are accepted as unicast
+   ones. The MAC receives all the frames, so joining only requires an IGMPv2 membership report to
+   get the group forwarded by switches doing IGMP snooping. */
+#define IP_PROTO_IGMP			0x02
+#define IGMP_V2_MEMBERSHIP_REPORT	0x16
+
+static unsigned int multicast_ip;
+
+static void igmp_send_report(unsigned int group)
+{
+	unsigned char mac[6];
+	unsigned char *ip;
+	unsigned char *igmp;
+	unsigned int i;
+
+	/* Multicast MAC: 01:00:5e + 23 LSBs of group */
+	mac[0] = 0x01;
+	mac[1] = 0x00;
+	mac[2] = 0x5e;
+	mac[3] = (group >> 16) & 0x7f;
+	mac[4] = (group >>  8) & 0xff;
+	mac[5] = (group >>  0) & 0xff;
+	fill_eth_header(&tx_get_buffer()->frame.eth_header, mac, my_mac, ETHERTYPE_IP);
+	txlen = ARP_PACKET_LENGTH;
+	ip = (unsigned char *)&txbuffer->frame.contents;
+	for(i=0;i<txlen - sizeof(struct ethernet_header);i++)
+		ip[i] = 0;
+
+	/* IP header with Router Alert option (RFC 2236) */
+	ip[0]  = 0x46;
+	ip[1]  = 0xc0;
+	ip[3]  = 24 + 8;
+	ip[8]  = 1; /* TTL */
+	ip[9]  = IP_PROTO_IGMP;
+	ip[12] = my_ip >> 24;
+	ip[13] = my_ip >> 16;
+	ip[14] = my_ip >>  8;
+	ip[15] = my_ip >>  0;
+	ip[16] = group >> 24;
+	ip[17] = group >> 16;
+	ip[18] = group >>  8;
+	ip[19] = group >>  0;
+	ip[20] = 0x94;
+	ip[21] = 0x04;
+	*(unsigned short *)&ip[10] = htons(ip_checksum(0, ip, 24, 1));
+
+	/* IGMPv2 Membership Report */
+	igmp = ip + 24;
+	igmp[0] = IGMP_V2_MEMBERSHIP_REPORT;
+	igmp[4] = group >> 24;
+	igmp[5] = group >> 16;
+	igmp[6] = group >>  8;
+	igmp[7] = group >>  0;
+	*(unsigned short *)&igmp[2] = htons(ip_checksum(0, igmp, 8, 1));
+
+	send_packet();
+}
+
+void udp_join_multicast(unsigned int group)
+{
+	multicast_ip = group;
+	if(group)
+		igmp_send_report(group);
+}
+
 static udp_callback rx_callback;
 
+/* Receive buffers (zero-copy API): the payload of the datagrams received on a flow's port is
+   copied once from the RX slot to the flow's buffer (used as a ring) and the UDP checksum is
+   verified during the copy. The ring is filled at offset and released up to tail by the consumer;
+   used counts the bytes not yet released (including the unused end of the buffer when wrapping). */
+struct udp_rx_flow {
+	unsigned short port;
+	unsigned char *buffer;
+	unsigned int size;
+	unsigned int offset;
+	unsigned int tail;
+	unsigned int used;
+	unsigned int overruns;
+	udp_rx_notify notify;
+};
+
+static struct udp_rx_flow rx_flows[UDP_RX_FLOWS];
+
+int udp_set_rx_buffer(unsigned short port, void *buffer, unsigned int size, udp_rx_notify notify)
+{
+	struct udp_rx_flow *free_flow = NULL;
+	int i;
+
+	for(i=0;i<UDP_RX_FLOWS;i++) {
+		if(rx_flows[i].buffer && (rx_flows[i].port == port)) {
+			free_flow = &rx_flows[i];
+			break;
+		}
+		if(!rx_flows[i].buffer && !free_flow)
+			free_flow = &rx_flows[i];
+	}
+	if(!free_flow)
+		return 0;
+	free_flow->port   = port;
+	free_flow->buffer = buffer;
+	free_flow->size   = buffer ? size : 0;
+	free_flow->offset   = 0;
+	free_flow->tail     = 0;
+	free_flow->used     = 0;
+	free_flow->overruns = 0;
+	free_flow->notify   = notify;
+	return 1;
+}
+
+static struct udp_rx_flow *find_rx_flow(unsigned short port)
+{
+	int i;
+
+	for(i=0;i<UDP_RX_FLOWS;i++)
+		if(rx_flows[i].buffer && (rx_flows[i].port == port))
+			return &rx_flows[i];
+	return NULL;
+}
+
+void udp_set_rx_offset(unsigned short port, unsigned int offset)
+{
+	struct udp_rx_flow *flow = find_rx_flow(port);
+
+	if(!flow || (offset > flow->size))
+		return;
+	flow->offset = offset;
+	flow->tail   = offset;
+	flow->used   = 0;
+}
+
+void udp_rx_release(unsigned short port, unsigned int offset)
+{
+	struct udp_rx_flow *flow = find_rx_flow(port);
+
+	if(!flow)
+		return;
+	if(offset >= flow->size)
+		offset = 0;
+	flow->tail = offset;
+	if(offset == flow->offset)
+		flow->used = 0;
+	else if(offset < flow->offset)
+		flow->used = flow->offset - offset;
+	else
+		flow->used = flow->size - offset + flow->offset;
+}
+
+unsigned int udp_get_rx_overruns(unsigned short port)
+{
+	struct udp_rx_flow *flow = find_rx_flow(port);
+
+	return flow ? flow->overruns : 0;
+}
+
+/* Copy length bytes and return their one's complement sum (in memory order, 32-bit accumulator
+   with deferred carries). The source is 16-bit aligned (payload in the RX slot); 32-bit
+   accesses are used when source and destination have the same alignment. */
+
+static uint32_t copy_and_sum(void *dst, const void *src, unsigned int length)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	uint32_t sum = 0;
+	uint16_t h;
+
+	if(((uintptr_t)d & 3) == ((uintptr_t)s & 3)) {
+		if(((uintptr_t)s & 3) && (length >= 2)) {
+			h = *(const sum_half_t *)s;
+			*(sum_half_t *)d = h;
+			sum += h;
+			d += 2;
+			s += 2;
+			length -= 2;
+		}
+		while(length >= 4) {
+			uint32_t w = *(const sum_word_t *)s;
+			*(sum_word_t *)d = w;
+			sum += (w & 0xffff) + (w >> 16);
+			d += 4;
+			s += 4;
+			length -= 4;
+		}
+	}
+	if(!((uintptr_t)d & 1)) {
+		while(length >= 2) {
+			h = *(const sum_half_t *)s;
+			*(sum_half_t *)d = h;
+			sum += h;
+			d += 2;
+			s += 2;
+			length -= 2;
+		}
+	} else {
+		while(length >= 2) {
+			d[0] = s[0];
+			d[1] = s[1];
+			sum += *(const sum_half_t *)s;
+			d += 2;
+			s += 2;
+			length -= 2;
+		}
+	}
+	if(length) {
+		h = 0;
+		*(uint8_t *)&h = *s;
+		*d = *s;
+		sum += h;
+	}
+
+	/* Add overflows */
+	while(sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
+
+static int process_rx_flow(struct udp_rx_flow *flow, struct udp_frame *udp_ip, unsigned int length)
+{
+	struct pseudo_header h;
+	unsigned int offset;
+	unsigned int skip;
+	unsigned int r;
+
+	/* Datagrams are never split: wrap (skipping the end of the buffer) when needed, and drop
+	   the datagram (counting the overrun) when the consumer has not released enough space. */
+	offset = flow->offset;
+	skip   = 0;
+	if(offset + length > flow->size) {
+		skip   = flow->size - offset;
+		offset = 0;
+	}
+	if(flow->used + skip + length > flow->size) {
+		flow->overruns++;
+		return 0;
+	}
+
+	/* Copy payload and compute its sum, converted to network order. */
+	r = copy_and_sum(flow->buffer + offset, udp_ip->payload, length);
+	r = ntohs(r);
+
+	/* Verify UDP checksum (when used by the sender). */
+	if(udp_ip->udp.checksum != 0) {
+		h.src_ip = udp_ip->ip.src_ip;
+		h.dst_ip = udp_ip->ip.dst_ip;
+		h.zero   = 0;
+		h.proto  = IP_PROTO_UDP;
+		h.length = udp_ip->udp.length;
+		r = ip_checksum(r, &h, sizeof(struct pseudo_header), 0);
+		r = ip_checksum(r, &udp_ip->udp, sizeof(struct udp_header), 0);
+		if(r != 0xffff)
+			return 1;
+	}
+
+	flow->offset = offset + length;
+	flow->used  += skip + length;
+	if(flow->notify)
+		flow->notify(ntohl(udp_ip->ip.src_ip), ntohs(udp_ip->udp.src_port), flow->port, offset, length);
+	return 1;
+}
+
 static void process_ip(void)
 {
+	unsigned int length;
+	int i;
+
 	if(rxlen < (sizeof(struct ethernet_header)+sizeof(struct udp_frame))) return;
 	struct udp_frame *udp_ip = &rxbuffer->frame.contents.udp;
-	/* We don't verify UDP and IP checksums and rely on the Ethernet checksum solely */
+	/* We don't verify the IP checksum and rely on the Ethernet checksum. The UDP checksum is only
+	   verified for the zero-copy receive flows (see process_rx_flow). */
 	if(udp_ip->ip.version != IP_IPV4) return;
 	// check disabled for QEMU compatibility
 	//if(rxbuffer->frame.contents.udp.ip.diff_services != 0) return;
@@ -379,12 +749,21 @@ static void process_ip(void)
 	// check disabled for QEMU compatibility
 	//if(ntohs(rxbuffer->frame.contents.udp.ip.fragment_offset) != IP_DONT_FRAGMENT) return;
 	if(udp_ip->ip.proto != IP_PROTO_UDP) return;
-	if(ntohl(udp_ip->ip.dst_ip) != my_ip) return;
+	if((ntohl(udp_ip->ip.dst_ip) != my_ip) &&
+	   ((multicast_ip == 0) || (ntohl(udp_ip->ip.dst_ip) != multicast_ip))) return;
 	if(ntohs(udp_ip->udp.length) < sizeof(struct udp_header)) return;
+	length = ntohs(udp_ip->udp.length)-sizeof(struct udp_header);
+	if(length > rxlen - (sizeof(struct ethernet_header)+sizeof(struct udp_frame))) return;
+
+	for(i=0;i<UDP_RX_FLOWS;i++)
+		if(rx_flows[i].buffer && (rx_flows[i].port == ntohs(udp_ip->udp.dst_port))) {
+			process_rx_flow(&rx_flows[i], udp_ip, length);
+			return;
+		}
 
 	if(rx_callback)
 		rx_callback(ntohl(udp_ip->ip.src_ip), ntohs(udp_ip->udp.src_port), ntohs(udp_ip->udp.dst_port),
-			    udp_ip->payload, ntohs(udp_ip->udp.length)-sizeof(struct udp_header));
+			    udp_ip->payload, length);
 }
 
 void udp_set_callback(udp_callback callback)
@@ -448,11 +827,20 @@ void udp_start(const unsigned char *macaddr, unsigned int ip)
 	rxslot = 0;
 	rxbuffer = (ethernet_buffer *)(ETHMAC_BASE + ETHMAC_SLOT_SIZE * rxslot);
 	rx_callback = (udp_callback)0;
+	multicast_ip = 0;
+	for(i=0;i<UDP_RX_FLOWS;i++)
+		rx_flows[i].buffer = NULL;
 }
 
 void udp_service(void)
 {
-	if(ethmac_sram_writer_ev_pending_read() & ETHMAC_EV_SRAM_WRITER) {
+	int i;
+
+	/* Drain all the RX slots filled by the MAC (bounded to the number of slots, so a flood of
+	   frames can't stall the caller). */
+	for(i=0;i<ETHMAC_RX_SLOTS;i++) {
+		if(!(ethmac_sram_writer_ev_pending_read() & ETHMAC_EV_SRAM_WRITER))
+			break;
 		rxslot = ethmac_sram_writer_slot_read();
 		rxbuffer = (ethernet_buffer *)(ETHMAC_BASE + ETHMAC_SLOT_SIZE * rxslot);
 		rxlen = ethmac_sram_writer_length_read();
@@ -10,14 +10,39 @@
 
 typedef void (*udp_callback)(unsigned int src_ip, unsigned short src_port, unsigned short dst_port, void *data, unsigned int length);
 
+/* Zero-copy receive: the payload of the datagrams received on port is copied to buffer (used as
+   a ring, datagrams are never split) and notify is called with its offset/length in the buffer.
+   The consumer releases the buffer up to an offset (end of the last consumed datagram) with
+   udp_rx_release(); datagrams that don't fit in the released space are dropped and counted as
+   overruns. Datagrams with an invalid UDP checksum are dropped. A NULL buffer removes the port.
+   udp_set_rx_offset() places the next datagram at offset (ignored when offset > size) and releases
+   the whole buffer. */
+#ifndef UDP_RX_FLOWS
+#define UDP_RX_FLOWS 4
+#endif
+
+typedef void (*udp_rx_notify)(unsigned int src_ip, unsigned short src_port, unsigned short dst_port, unsigned int offset, unsigned int length);
+
 void udp_set_ip(unsigned int ip);
 void udp_set_mac(const unsigned char *macaddr);
 void udp_start(const unsigned char *macaddr, unsigned int ip);
 int udp_arp_resolve(unsigned int ip);
 void *udp_get_tx_buffer(void);
 int udp_send(unsigned short src_port, unsigned short dst_port, unsigned int length);
+
+/* Incremental checksum: udp_checksum_partial() returns the partial sum of a payload, that can
+   be updated with udp_checksum_update() when a 16/32-bit field (at an even offset) of the payload
+   changes, and passed to udp_send_sum() that then only sums the IP/UDP headers. */
+unsigned int udp_checksum_partial(const void *data, unsigned int length);
+unsigned int udp_checksum_update(unsigned int sum, unsigned int old_value, unsigned int new_value);
+int udp_send_sum(unsigned short src_port, unsigned short dst_port, unsigned int length, unsigned int payload_sum);
 void udp_set_callback(udp_callback callback);
+void udp_join_multicast(unsigned int group);
 void udp_service(void);
+int udp_set_rx_buffer(unsigned short port, void *buffer, unsigned int size, udp_rx_notify notify);
+void udp_set_rx_offset(unsigned short port, unsigned int offset);
+void udp_rx_release(unsigned short port, unsigned int offset);
+unsigned int udp_get_rx_overruns(unsigned short port);
 
 void eth_init(void);
 void eth_mode(void);
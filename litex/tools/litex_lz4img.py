@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+
+#
+# This file is part of LiteX.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+
+import argparse
+import binascii
+
+# LZ4 compressed boot image generator.
+#
+# The BIOS detects compressed images (flash, SDCard, SATA, network and serial boot) from their
+# 16-byte header and decompresses them on the fly to their RAM address:
+#
+#   magic             : b"LXZ4"
+#   length            : 32-bit, decompressed length.
+#   compressed_length : 32-bit, LZ4 block length.
+#   crc               : 32-bit, CRC32 of the decompressed data.
+#
+# (all little-endian) followed by the LZ4 block. For flash boot, the compressed image is written
+# directly to the flash boot address (instead of the Flash Boot Image).
+
+lz4_image_magic = b"LXZ4"
+
+# LZ4 Block Compression ----------------------------------------------------------------------------
+
+def _lz4_length(n):
+    r = bytearray()
+    while n >= 255:
+        r.append(255)
+        n -= 255
+    r.append(n)
+    return r
+
+def _lz4_sequence(literals, offset=None, match_length=0):
+    r  = bytearray()
+    ll = len(literals)
+    ml = match_length - 4
+    r.append((min(ll, 15) << 4) | (min(ml, 15) if offset is not None else 0))
+    if ll >= 15:
+        r += _lz4_length(ll - 15)
+    r += literals
+    if offset is not None:
+        r += offset.to_bytes(2, "little")
+        if ml >= 15:
+            r += _lz4_length(ml - 15)
+    return r
+
+def lz4_block_compress(data):
+    # Use the LZ4 library when available (faster and better ratio).
+    try:
+        import lz4.block
+        return lz4.block.compress(bytes(data), mode="high_compression", store_size=False)
+    except ImportError:
+        pass
+
+    # Else use a simple greedy compressor, following the LZ4 end of block rules (the last match
+    # starts at least 12 bytes before the end, the last 5 bytes are literals).
+    n      = len(data)
+    r      = bytearray()
+    table  = {}
+    anchor = 0
+    i      = 0
+    while i < n - 12:
+        sequence = data[i:i+4]
+        ref = table.get(sequence)
+        table[sequence] = i
+        if (ref is not None) and (i - ref <= 65535):
+            length = 4
+            while (i + length < n - 5) and (data[ref + length] == data[i + length]):
+                length += 1
+            r += _lz4_sequence(data[anchor:i], i - ref, length)
+            i     += length
+            anchor = i
+        else:
+            i += 1
+    r += _lz4_sequence(data[anchor:])
+    return bytes(r)
+
+# LZ4 Image ----------------------------------------------------------------------------------------
+
+def lz4_image(data):
+    compressed = lz4_block_compress(data)
+    header  = lz4_image_magic
+    header += len(data).to_bytes(4, "little")
+    header += len(compressed).to_bytes(4, "little")
+    header += binascii.crc32(data).to_bytes(4, "little")
+    return header + compressed
+
+def main():
+    parser = argparse.ArgumentParser(description="LZ4 compressed boot image generator.")
+    parser.add_argument("input",                         help="Input file.")
+    parser.add_argument("-o", "--output", default=None,  help="Output file (if not specified, use input file + .lz4).")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+    image = lz4_image(data)
+    with open(args.output or (args.input + ".lz4"), "wb") as f:
+        f.write(image)
+    print(f"{args.input}: {len(data)} -> {len(image)} bytes ({100*len(image)/max(len(data), 1):.1f}%).")
+
+if __name__ == "__main__":
+    main()
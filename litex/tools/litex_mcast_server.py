@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+#
+# This file is part of LiteX.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+
+import time
+import zlib
+import socket
+import select
+import argparse
+
+# Multicast Server ---------------------------------------------------------------------------------
+
+# Server side of the BIOS multicast boot ("netboot mcast", see libliteeth/mcast.c): the image is
+# sent as a sequenced block stream to a multicast group, followed by END packets; boards then
+# request their missing blocks by unicast (REPAIR), which are resent to them directly.
+
+MCAST_PORT  = 6071
+MCAST_GROUP = "239.255.76.88"
+
+MCAST_DATA   = 1
+MCAST_END    = 2
+MCAST_REPAIR = 3
+
+MCAST_HEADER_LEN = 20
+
+class MCastServer:
+    def __init__(self, data, group=MCAST_GROUP, port=MCAST_PORT, block_size=1024, rate=100e6, ttl=1, interface=None):
+        self.data       = data
+        self.group      = group
+        self.port       = port
+        self.block_size = block_size
+        self.blocks     = (len(data) + block_size - 1)//block_size
+        self.crc        = zlib.crc32(data)
+        self.rate       = rate
+        self.sock       = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, ttl)
+        if interface is not None:
+            self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(interface))
+        self.sock.bind(("", port))
+        self.next_send  = time.time()
+
+    def header(self, cmd, block=0):
+        h  = bytes([cmd, 0])
+        h += self.block_size.to_bytes(2, "big")
+        h += block.to_bytes(4, "big")
+        h += self.blocks.to_bytes(4, "big")
+        h += len(self.data).to_bytes(4, "big")
+        h += self.crc.to_bytes(4, "big")
+        return h
+
+    def send(self, packet, dest):
+        # Rate limiting: boards only have a few MAC RX slots, don't overrun them.
+        now = time.time()
+        if self.next_send > now:
+            time.sleep(self.next_send - now)
+        self.next_send = max(now, self.next_send) + 8*(len(packet) + 28)/self.rate
+        self.sock.sendto(packet, dest)
+
+    def send_block(self, block, dest):
+        offset = block*self.block_size
+        self.send(self.header(MCAST_DATA, block) + self.data[offset:offset + self.block_size], dest)
+
+    def service_repairs(self, timeout=0):
+        # Resend the ranges requested by the boards (unicast).
+        while select.select([self.sock], [], [], timeout)[0]:
+            timeout = 0
+            packet, addr = self.sock.recvfrom(2048)
+            if (len(packet) < MCAST_HEADER_LEN) or (packet[0] != MCAST_REPAIR):
+                continue
+            if int.from_bytes(packet[16:20], "big") != self.crc:
+                continue
+            ranges = packet[MCAST_HEADER_LEN:]
+            count  = 0
+            for i in range(0, len(ranges) - 7, 8):
+                start = int.from_bytes(ranges[i + 0:i + 4], "big")
+                n     = int.from_bytes(ranges[i + 4:i + 8], "big")
+                for block in range(start, min(start + n, self.blocks)):
+                    self.send_block(block, addr)
+                    count += 1
+            print(f"Repaired {count} blocks for {addr[0]}.")
+
+    def run(self, rounds=1, linger=10):
+        dest = (self.group, self.port)
+        for r in range(rounds):
+            print(f"Round {r + 1}/{rounds}: sending {len(self.data)} bytes ({self.blocks} blocks) to {self.group}:{self.port}...")
+            for block in range(self.blocks):
+                self.send_block(block, dest)
+                if block % 64 == 0:
+                    self.service_repairs()
+            # End of stream, then serve the repairs.
+            end = time.time() + linger
+            while time.time() < end:
+                self.send(self.header(MCAST_END), dest)
+                self.service_repairs(timeout=0.2)
+
+# Run ----------------------------------------------------------------------------------------------
+
+def main():
+    parser = argparse.ArgumentParser(description="LiteX BIOS multicast boot server.")
+    parser.add_argument("image",                                          help="Image to send (boot.bin, can be LZ4 compressed).")
+    parser.add_argument("--group",      default=MCAST_GROUP,              help="Multicast group.")
+    parser.add_argument("--port",       default=MCAST_PORT,  type=int,    help="UDP port.")
+    parser.add_argument("--interface",  default=None,                     help="IP address of the interface to send from.")
+    parser.add_argument("--block-size", default=1024,        type=int,    help="Block size (bytes).")
+    parser.add_argument("--rate",       default=100e6,       type=float,  help="Rate limit (bits/s).")
+    parser.add_argument("--rounds",     default=1,           type=int,    help="Number of times the stream is sent (0: forever).")
+    parser.add_argument("--linger",     default=10,          type=float,  help="Time serving repairs after each round (s).")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        data = f.read()
+    server = MCastServer(data,
+        group      = args.group,
+        port       = args.port,
+        block_size = args.block_size,
+        rate       = args.rate,
+        interface  = args.interface,
+    )
+    if args.rounds == 0:
+        while True:
+            server.run(rounds=1, linger=args.linger)
+    else:
+        server.run(rounds=args.rounds, linger=args.linger)
+
+if __name__ == "__main__":
+    main()
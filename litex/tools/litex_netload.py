@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+
+#
+# This file is part of LiteX.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+
+import time
+import zlib
+import socket
+import argparse
+import threading
+
+# Network Load -------------------------------------------------------------------------------------
+
+# Host side of the BIOS "netload" command: images are streamed to the BIOS as sequenced UDP
+# "write data at address" datagrams, acknowledged with cumulative ACKs (next expected sequence and
+# bitmap of the following sequences received), then verified with their CRC32 before the jump.
+
+NETLOAD_PORT = 6070
+
+NETLOAD_CMD_HELLO  = 0x00
+NETLOAD_CMD_WRITE  = 0x01
+NETLOAD_CMD_VERIFY = 0x02
+NETLOAD_CMD_JUMP   = 0x03
+NETLOAD_CMD_EXIT   = 0x04
+NETLOAD_CMD_ACK    = 0x80
+
+NETLOAD_STATUS_OK      = 0x00
+NETLOAD_STATUS_CRC     = 0x01
+NETLOAD_STATUS_MISSING = 0x02
+NETLOAD_STATUS_BUSY    = 0x03
+NETLOAD_STATUS_RANGE   = 0x04
+
+NETLOAD_BITMAP = 32 # Sequences tracked after the expected one by the BIOS.
+
+def netload_packet(cmd, seq, address, payload=b""):
+    header  = bytes([cmd, 0, 0, 0])
+    header += seq.to_bytes(4, "big")
+    header += address.to_bytes(4, "big")
+    return header + payload
+
+class NetLoad:
+    def __init__(self, ip, port=NETLOAD_PORT, chunk_size=1024, window=16, timeout=0.1, retries=50):
+        assert window <= NETLOAD_BITMAP
+        self.ip         = ip
+        self.port       = port
+        self.chunk_size = chunk_size
+        self.window     = window
+        self.timeout    = timeout
+        self.retries    = retries
+        self.sock       = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+        self.seq        = 0
+
+    def log(self, msg):
+        print(f"[{self.ip}] {msg}")
+
+    def send(self, packet):
+        self.sock.sendto(packet, (self.ip, self.port))
+
+    def receive_ack(self):
+        try:
+            data, addr = self.sock.recvfrom(64)
+        except socket.timeout:
+            return None
+        if (addr[0] != self.ip) or (len(data) < 12) or (data[0] != NETLOAD_CMD_ACK):
+            return None
+        status   = data[1]
+        expected = int.from_bytes(data[4:8],  "big")
+        received = int.from_bytes(data[8:12], "big")
+        return status, expected, received
+
+    def command(self, cmd, address=0, payload=b""):
+        # Commands are sequenced and executed once all the previous writes have been received.
+        # Long commands (VERIFY) are acknowledged with a BUSY status (keepalive) until done.
+        seq = self.seq
+        self.seq += 1
+        retries = 0
+        while retries < self.retries:
+            retries += 1
+            self.send(netload_packet(cmd, seq, address, payload))
+            deadline = time.time() + self.timeout
+            while time.time() < deadline:
+                ack = self.receive_ack()
+                if ack is None:
+                    continue
+                status, expected, _ = ack
+                if expected > seq:
+                    return status
+                if status == NETLOAD_STATUS_BUSY:
+                    retries = 0
+        raise TimeoutError(f"No answer from {self.ip}:{self.port}")
+
+    def hello(self):
+        for _ in range(self.retries):
+            self.send(netload_packet(NETLOAD_CMD_HELLO, 0, 0))
+            ack = self.receive_ack()
+            if ack is not None and ack[1] == 0:
+                self.seq = 0
+                return
+        raise TimeoutError(f"No answer from {self.ip}:{self.port} (netload not running?)")
+
+    def write(self, data, address):
+        frames = []
+        for offset in range(0, len(data), self.chunk_size):
+            chunk = data[offset:offset + self.chunk_size]
+            frames.append(netload_packet(NETLOAD_CMD_WRITE, self.seq + len(frames), address + offset, chunk))
+        first   = self.seq
+        base    = 0 # First frame not acknowledged.
+        next    = 0 # Next frame to send.
+        sacked  = set()
+        sent_at = {}
+        resent  = set()
+        retries = 0
+        while base < len(frames):
+            # Fill the window.
+            while (next < len(frames)) and (next < base + self.window):
+                if next not in sacked:
+                    self.send(frames[next])
+                    sent_at[next] = time.time()
+                next += 1
+            ack = self.receive_ack()
+            if ack is None:
+                # Timeout: retransmit the window (except the frames already received).
+                retries += 1
+                if retries > self.retries:
+                    raise TimeoutError(f"No answer from {self.ip}:{self.port}")
+                next = base
+                continue
+            retries = 0
+            status, expected, received = ack
+            if status == NETLOAD_STATUS_RANGE:
+                raise ValueError(f"Write to 0x{address:08x} rejected (overlaps BIOS RAM)")
+            expected -= first
+            if expected > base:
+                base = min(expected, len(frames))
+                next = max(next, base)
+                sacked = {n for n in sacked if n >= base}
+            for i in range(NETLOAD_BITMAP):
+                if received & (1 << i):
+                    sacked.add(expected + 1 + i)
+            # Holes: frames sent before a received one are lost, retransmit them immediately the
+            # first time, then once per timeout.
+            if sacked:
+                now = time.time()
+                for n in range(base, min(max(sacked), next)):
+                    if n in sacked:
+                        continue
+                    if (n not in resent) or (now - sent_at.get(n, 0) > self.timeout):
+                        self.send(frames[n])
+                        sent_at[n] = now
+                        resent.add(n)
+        self.seq = first + len(frames)
+
+    def verify(self, data, address):
+        payload  = address.to_bytes(4, "big")
+        payload += len(data).to_bytes(4, "big")
+        payload += zlib.crc32(data).to_bytes(4, "big")
+        return self.command(NETLOAD_CMD_VERIFY, payload=payload) == NETLOAD_STATUS_OK
+
+    def jump(self, address):
+        self.command(NETLOAD_CMD_JUMP, address=address)
+
+    def exit(self):
+        self.command(NETLOAD_CMD_EXIT)
+
+    def load(self, images, jump=None):
+        self.hello()
+        for filename, address in images:
+            with open(filename, "rb") as f:
+                data = f.read()
+            self.log(f"Loading {filename} to 0x{address:08x} ({len(data)} bytes)...")
+            start = time.time()
+            self.write(data, address)
+            duration = time.time() - start
+            if not self.verify(data, address):
+                raise ValueError(f"CRC error on {filename}")
+            self.log(f"{filename} loaded in {duration:.2f}s ({8*len(data)/(duration*1e6):.1f}Mbps), CRC OK.")
+        if jump is None:
+            self.exit()
+        else:
+            self.log(f"Jumping to 0x{jump:08x}...")
+            self.jump(jump)
+
+# Run ----------------------------------------------------------------------------------------------
+
+def parse_image(image):
+    filename, _, address = image.rpartition("@")
+    if not filename:
+        raise argparse.ArgumentTypeError(f"Invalid image {image}, expected <file>@<address>.")
+    return filename, int(address, 0)
+
+def main():
+    parser = argparse.ArgumentParser(description="LiteX BIOS network loader (netload).")
+    parser.add_argument("--ip",         action="append", required=True,          help="Board IP address (can be specified multiple times).")
+    parser.add_argument("--port",       default=NETLOAD_PORT,  type=int,         help="Board UDP port.")
+    parser.add_argument("--image",      action="append", required=True, type=parse_image, help="Image to load as <file>@<address> (can be specified multiple times).")
+    parser.add_argument("--jump",       default=None,                            help="Jump address (default: address of the first image).")
+    parser.add_argument("--no-jump",    action="store_true",                     help="Return to the BIOS console after the load.")
+    parser.add_argument("--chunk-size", default=1024,          type=int,         help="Data per datagram (bytes).")
+    parser.add_argument("--window",     default=16,            type=int,         help="Datagrams in flight (max 32, limited by the MAC RX slots).")
+    args = parser.parse_args()
+
+    jump = None
+    if not args.no_jump:
+        jump = int(args.jump, 0) if args.jump is not None else args.image[0][1]
+
+    # Load boards in parallel.
+    errors  = []
+    def run(ip):
+        try:
+            NetLoad(ip, args.port, args.chunk_size, args.window).load(args.image, jump)
+        except Exception as e:
+            errors.append(ip)
+            print(f"[{ip}] Error: {e}")
+    threads = [threading.Thread(target=run, args=(ip,)) for ip in args.ip]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    if errors:
+        raise SystemExit(1)
+
+if __name__ == "__main__":
+    main()
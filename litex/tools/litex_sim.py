@@ -8,6 +8,7 @@
 # Copyright (c) 2017 Pierre-Olivier Vauboin <po@lambdaconcept>
 # SPDX-License-Identifier: BSD-2-Clause
 
+import os
 import sys
 import argparse
 
@@ -155,6 +156,7 @@ class SimSoC(SoCCore):
         with_spi_flash        = False,
         spi_flash_init        = [],
         with_gpio             = False,
+        with_dma              = False,
         sim_debug             = False,
         trace_reset_on        = False,
         **kwargs):
@@ -290,6 +292,10 @@ class SimSoC(SoCCore):
             self.submodules.gpio = GPIOTristate(platform.request("gpio"), with_irq=True)
             self.irq.add("gpio", use_loc_if_exists=True)
 
+        # DMA (Memory to memory copy/fill) ----------------------------------------------------------
+        if with_dma:
+            self.add_dma()
+
         # Simulation debugging ----------------------------------------------------------------------
         if sim_debug:
             platform.add_debug(self, reset=1 if trace_reset_on else 0)
@@ -385,9 +391,13 @@ def sim_args(parser):
     parser.add_argument("--with-spi-flash",       action="store_true",     help="Enable SPI Flash (MMAPed).")
     parser.add_argument("--spi_flash-init",       default=None,            help="SPI Flash init file.")
     parser.add_argument("--with-gpio",            action="store_true",     help="Enable Tristate GPIO (32 pins).")
+    parser.add_argument("--with-dma",             action="store_true",     help="Enable memory to memory DMA (used by the BIOS copies).")
     parser.add_argument("--sim-debug",            action="store_true",     help="Add simulation debugging modules.")
     parser.add_argument("--gtkwave-savefile",     action="store_true",     help="Generate GTKWave savefile.")
     parser.add_argument("--non-interactive",      action="store_true",     help="Run simulation without user input.")
+    parser.add_argument("--serial-script",        default=None,            help="Drive the UART from a script file (serial2script, implies --non-interactive).")
+    parser.add_argument("--serial-script-timeout",default=0,               help="Script timeout (sys_clk cycles, 0: none).")
+    parser.add_argument("--serial-script-log",    default=None,            help="Save timestamped UART output to file.")
 
 def main():
     from litex.soc.integration.soc import LiteXSoCArgumentParser
@@ -411,7 +421,13 @@ def main():
     # UART.
     if soc_kwargs["uart_name"] == "serial":
         soc_kwargs["uart_name"] = "sim"
-        sim_config.add_module("serial2console", "serial")
+        if args.serial_script is not None:
+            script_args = {"script": os.path.abspath(args.serial_script), "timeout": int(float(args.serial_script_timeout))}
+            if args.serial_script_log is not None:
+                script_args["log"] = os.path.abspath(args.serial_script_log)
+            sim_config.add_module("serial2script", "serial", args=script_args)
+        else:
+            sim_config.add_module("serial2console", "serial")
 
     # ROM.
     if args.rom_init:
@@ -473,6 +489,7 @@ def main():
         with_sdcard        = args.with_sdcard,
         with_spi_flash     = args.with_spi_flash,
         with_gpio          = args.with_gpio,
+        with_dma           = args.with_dma,
         sim_debug          = args.sim_debug,
         trace_reset_on     = int(float(args.trace_start)) > 0 or int(float(args.trace_end)) > 0,
         spi_flash_init     = None if args.spi_flash_init is None else get_mem_data(args.spi_flash_init, endianness="big"),
@@ -495,7 +512,7 @@ def main():
     builder = Builder(soc, **builder_kwargs)
     builder.build(
         sim_config       = sim_config,
-        interactive      = not args.non_interactive,
+        interactive      = not (args.non_interactive or args.serial_script is not None),
         pre_run_callback = pre_run_callback,
         **verilator_build_kwargs,
     )
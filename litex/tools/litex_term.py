@@ -18,6 +18,8 @@ import multiprocessing
 import argparse
 import json
 import socket
+import zlib
+import tempfile
 
 # Console ------------------------------------------------------------------------------------------
 
@@ -206,10 +208,19 @@ sfl_magic_ack = b"z6IHG7cYDID6o\n"
 
 sfl_payload_length  = 255
 
+# SFL v2 (advertised by the device before the magic request)
+sfl_magic_req_v2 = b"sL5DdSMmkekr2\n"
+sfl_magic_ack_v2 = b"z6IHG7cYDID62\n"
+
+sfl_v2_flag_crc32     = 0x01
+sfl_v2_window_max     = 32
+sfl_v2_payload_length = 1024
+
 # General commands
 sfl_cmd_abort       = b"\x00"
 sfl_cmd_load        = b"\x01"
 sfl_cmd_jump        = b"\x02"
+sfl_cmd_lz4         = b"\x03"
 
 # Replies
 sfl_ack_success  = b"K"
@@ -233,6 +244,21 @@ class SFLFrame:
         packet += self.payload
         return packet
 
+class SFLFrameV2:
+    def __init__(self, seq, cmd, payload=bytes(), use_crc32=False):
+        self.seq       = seq & 0xff
+        self.cmd       = cmd
+        self.payload   = payload
+        self.use_crc32 = use_crc32
+
+    def encode(self):
+        data  = bytes([self.seq])
+        data += self.cmd
+        data += len(self.payload).to_bytes(2, "big")
+        data += self.payload
+        crc   = zlib.crc32(data) if self.use_crc32 else crc16(data)
+        return crc.to_bytes(4, "big") + data
+
 # CRC16 --------------------------------------------------------------------------------------------
 
 crc16_table = [
@@ -280,7 +306,8 @@ def crc16(l):
 # LiteXTerm ----------------------------------------------------------------------------------------
 
 class LiteXTerm:
-    def __init__(self, serial_boot, kernel_image, kernel_address, json_images, safe):
+    def __init__(self, serial_boot, kernel_image, kernel_address, json_images, safe,
+        sfl_v2=True, sfl_v2_window=16, sfl_v2_crc32=False, lz4=False):
         self.serial_boot = serial_boot
         assert not (kernel_image is not None and json_images is not None)
         self.mem_regions = {}
@@ -298,6 +325,13 @@ class LiteXTerm:
         self.reader_alive = False
         self.writer_alive = False
 
+        self.sfl_v2          = sfl_v2 and not safe
+        self.sfl_v2_window   = min(sfl_v2_window, sfl_v2_window_max)
+        self.sfl_v2_crc32    = sfl_v2_crc32
+        self.sfl_v2_device   = False
+        self.sfl_v2_seq      = 0
+        self.lz4             = lz4
+
         self.prompt_detect_buffer = bytes(len(sfl_prompt_req))
         self.magic_detect_buffer  = bytes(len(sfl_magic_req))
 
@@ -493,8 +527,131 @@ class LiteXTerm:
         f.close()
         return length
 
+    def send_frames_v2(self, frames, progress=None):
+        # Send the frames in a sliding window: the device replies to each frame with a status and
+        # the next sequence number it expects (cumulative ACK) and keeps out of order frames: the
+        # first unacknowledged frame is retransmitted on errors, all the unacknowledged frames of
+        # the window on timeouts (the device re-acknowledges the ones it already has).
+        first_seq = frames[0].seq if len(frames) else 0
+        frames    = [frame.encode() for frame in frames]
+        base      = 0
+        sent      = 0
+        while base < len(frames):
+            # Fill the window.
+            while (sent < len(frames)) and (sent - base < self.sfl_v2_window):
+                self.port.write(frames[sent])
+                sent += 1
+
+            # Get reply (or retransmit the unacknowledged frames on timeout).
+            reply = self.port.read(2)
+            if len(reply) < 2:
+                for n in range(base, sent):
+                    self.port.write(frames[n])
+                continue
+            status, expected = reply[0:1], reply[1]
+
+            # Slide the window.
+            acked = (expected - (first_seq + base)) & 0xff
+            if acked <= (sent - base):
+                base += acked
+                if progress is not None:
+                    progress(base)
+
+            if status == sfl_ack_success:
+                continue
+            elif status in [sfl_ack_crcerror, sfl_ack_error]:
+                if base < sent:
+                    self.port.write(frames[base])
+            else:
+                # Resynchronize on the sequence number expected by the device.
+                self.sfl_v2_seq = expected
+                return False
+        return True
+
+    def upload_v2(self, filename, address):
+        f = open(filename, "rb")
+        data = f.read()
+        f.close()
+        length = len(data)
+
+        print(f"[LITEX-TERM] Uploading {filename} to 0x{address:08x} ({length} bytes, SFL v2)...")
+
+        # Prepare frames.
+        frames = []
+        chunk  = sfl_v2_payload_length - 4
+        for offset in range(0, length, chunk):
+            payload  = (address + offset).to_bytes(4, "big")
+            payload += data[offset:offset + chunk]
+            frames.append(SFLFrameV2(self.sfl_v2_seq, sfl_cmd_load, payload, self.sfl_v2_crc32))
+            self.sfl_v2_seq += 1
+
+        # Send frames.
+        def progress(n):
+            position = min(n*chunk, length)
+            sys.stdout.write("|{}>{}| {}%\r".format(
+                "=" * (20*position//length),
+                " " * (20-20*position//length),
+                100*position//length))
+            sys.stdout.flush()
+        start = time.time()
+        if not self.send_frames_v2(frames, progress):
+            print("[LITEX-TERM] Got unexpected response from device, aborting.")
+            sys.exit(1)
+
+        # Compute speed.
+        end     = time.time()
+        elapsed = end - start
+        print("[LITEX-TERM] Upload complete ({0:.1f}KB/s).".format(length/(elapsed*1024)))
+        return length
+
+    def upload_lz4(self, filename, address):
+        from litex.tools.litex_lz4img import lz4_image
+
+        # Compress image.
+        with open(filename, "rb") as f:
+            image = lz4_image(f.read())
+        with tempfile.NamedTemporaryFile(suffix=".lz4", delete=False) as f:
+            f.write(image)
+            lz4_filename = f.name
+
+        # Upload compressed image.
+        try:
+            if self.sfl_v2_device:
+                self.upload_v2(lz4_filename, address)
+            else:
+                self.upload(lz4_filename, address)
+        finally:
+            os.remove(lz4_filename)
+
+        # Decompress it (in place) on the device.
+        print("[LITEX-TERM] Decompressing the image on the device.")
+        payload = address.to_bytes(4, "big")
+        if self.sfl_v2_device:
+            frame = SFLFrameV2(self.sfl_v2_seq, sfl_cmd_lz4, payload, self.sfl_v2_crc32)
+            self.sfl_v2_seq += 1
+            success = self.send_frames_v2([frame])
+        else:
+            frame = SFLFrame()
+            frame.cmd     = sfl_cmd_lz4
+            frame.payload = payload
+            success = self.send_frame(frame)
+
+        # Fall back to uncompressed image when not supported by the device.
+        if not success:
+            print("[LITEX-TERM] LZ4 images not supported by the device, uploading uncompressed image.")
+            if self.sfl_v2_device:
+                self.upload_v2(filename, address)
+            else:
+                self.upload(filename, address)
+
     def boot(self):
         print("[LITEX-TERM] Booting the device.")
+        if self.sfl_v2_device:
+            frame = SFLFrameV2(self.sfl_v2_seq, sfl_cmd_jump,
+                int(self.boot_address, 16).to_bytes(4, "big"), self.sfl_v2_crc32)
+            self.sfl_v2_seq += 1
+            self.send_frames_v2([frame])
+            return
         frame = SFLFrame()
         frame.cmd = sfl_cmd_jump
         frame.payload = int(self.boot_address, 16).to_bytes(4, "big")
@@ -514,17 +671,38 @@ class LiteXTerm:
     def detect_magic(self, data):
         if len(data):
             self.magic_detect_buffer = self.magic_detect_buffer[1:] + data
+            if self.magic_detect_buffer == sfl_magic_req_v2:
+                self.sfl_v2_device = self.sfl_v2
             return self.magic_detect_buffer == sfl_magic_req
         else:
             return False
 
     def answer_magic(self):
         print("[LITEX-TERM] Received firmware download request from the device.")
-        if(len(self.mem_regions)):
-            self.port.write(sfl_magic_ack)
-        for filename, base in self.mem_regions.items():
-            self.upload(filename, int(base, 16))
-        self.boot()
+        if self.sfl_v2_device:
+            # Replies are binary and must not block on a lost frame, use a read timeout.
+            self.sfl_v2_seq = 0
+            timeout = self.port.timeout
+            self.port.timeout = 0.5
+            self.port.write(sfl_magic_ack_v2)
+            self.port.write(bytes([sfl_v2_flag_crc32 if self.sfl_v2_crc32 else 0]))
+            for filename, base in self.mem_regions.items():
+                if self.lz4:
+                    self.upload_lz4(filename, int(base, 16))
+                else:
+                    self.upload_v2(filename, int(base, 16))
+            self.boot()
+            self.port.timeout = timeout
+        else:
+            if(len(self.mem_regions)):
+                self.port.write(sfl_magic_ack)
+            for filename, base in self.mem_regions.items():
+                if self.lz4:
+                    self.upload_lz4(filename, int(base, 16))
+                else:
+                    self.upload(filename, int(base, 16))
+            self.boot()
+        self.sfl_v2_device = False
         print("[LITEX-TERM] Done.")
 
     def reader(self):
@@ -607,6 +785,10 @@ def _get_args():
     parser.add_argument("--kernel-adr",   default="0x40000000",               help="Kernel address.")
     parser.add_argument("--images",       default=None,                       help="JSON description of the images to load to memory.")
     parser.add_argument("--safe",         action="store_true",                help="Safe serial boot mode, disable upload speed optimizations.")
+    parser.add_argument("--no-sfl-v2",    action="store_true",                help="Disable SFL v2 (windowed) serial boot protocol, always use SFL v1.")
+    parser.add_argument("--sfl-window",   default=16,                         help="SFL v2 number of frames in flight (max 32).")
+    parser.add_argument("--sfl-crc32",    action="store_true",                help="Use CRC32 instead of CRC16 on SFL v2 frames.")
+    parser.add_argument("--lz4",          action="store_true",                help="Upload LZ4 compressed images (decompressed by the BIOS).")
 
     parser.add_argument("--csr-csv",        default=None,                       help="SoC CSV file.")
     parser.add_argument("--base-address",   default=None,                       help="CSR base address.")
@@ -619,7 +801,11 @@ def _get_args():
 
 def main():
     args = _get_args()
-    term = LiteXTerm(args.serial_boot, args.kernel, args.kernel_adr, args.images, args.safe)
+    term = LiteXTerm(args.serial_boot, args.kernel, args.kernel_adr, args.images, args.safe,
+        sfl_v2        = not args.no_sfl_v2,
+        sfl_v2_window = int(args.sfl_window),
+        sfl_v2_crc32  = args.sfl_crc32,
+        lz4           = args.lz4)
 
     if sys.platform == "win32":
         if args.port in ["crossover", "jtag"]:
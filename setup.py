@@ -37,9 +37,12 @@ setup(
     entry_points={
         "console_scripts": [
             # Terminal/Server/Client.
-            "litex_term   = litex.tools.litex_term:main",
-            "litex_server = litex.tools.litex_server:main",
-            "litex_cli    = litex.tools.litex_client:main",
+            "litex_term    = litex.tools.litex_term:main",
+            "litex_server  = litex.tools.litex_server:main",
+            "litex_cli     = litex.tools.litex_client:main",
+            "litex_netload = litex.tools.litex_netload:main",
+            "litex_mcast_server = litex.tools.litex_mcast_server:main",
+            "litex_lz4img  = litex.tools.litex_lz4img:main",
 
             # SoC Generators.
             "litex_soc_gen    = litex.tools.litex_soc_gen:main",
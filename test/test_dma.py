@@ -0,0 +1,114 @@
+#
+# This file is part of LiteX.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+
+import unittest
+
+from migen import *
+
+from litex.soc.interconnect import wishbone
+from litex.soc.cores.dma import WishboneDMAMem2Mem
+
+# DUT ----------------------------------------------------------------------------------------------
+
+class DMAMem2MemDUT(Module):
+    def __init__(self, mem_words=256, fifo_depth=16):
+        bus_reader = wishbone.Interface(data_width=32, adr_width=30)
+        bus_writer = wishbone.Interface(data_width=32, adr_width=30)
+        bus_sram   = wishbone.Interface(data_width=32, adr_width=30)
+        self.submodules.dma     = WishboneDMAMem2Mem(bus_reader, bus_writer, fifo_depth=fifo_depth)
+        self.submodules.arbiter = wishbone.Arbiter([bus_reader, bus_writer], bus_sram)
+        self.submodules.sram    = wishbone.SRAM(4*mem_words, init=list(range(mem_words)), bus=bus_sram)
+
+# Helpers ------------------------------------------------------------------------------------------
+
+def dma_run(dma, dst, src, length, fill=0, fill_value=0, timeout=4096):
+    yield from dma.writer._enable.write(0)
+    yield from dma.reader._enable.write(0)
+    yield from dma._fill.write(fill)
+    yield from dma._fill_value.write(fill_value)
+    yield from dma.writer._base.write(dst)
+    yield from dma.writer._length.write(length)
+    yield from dma.writer._enable.write(1)
+    if not fill:
+        yield from dma.reader._base.write(src)
+        yield from dma.reader._length.write(length)
+        yield from dma.reader._enable.write(1)
+    for i in range(timeout):
+        if (yield dma.writer._done.status):
+            break
+        yield
+    done = (yield dma.writer._done.status)
+    yield from dma.writer._enable.write(0)
+    yield from dma.reader._enable.write(0)
+    return done
+
+def mem_read(dut, start, count):
+    data = []
+    for i in range(count):
+        data.append((yield dut.sram.mem[start + i]))
+    return data
+
+# Test DMA -----------------------------------------------------------------------------------------
+
+class TestDMA(unittest.TestCase):
+    def dma_copy_test(self, src_word, dst_word, words):
+        def generator(dut):
+            done = yield from dma_run(dut.dma, dst=4*dst_word, src=4*src_word, length=4*words)
+            self.assertTrue(done)
+            # Copied words.
+            self.assertEqual((yield from mem_read(dut, dst_word, words)),
+                list(range(src_word, src_word + words)))
+            # Words around the destination are untouched.
+            self.assertEqual((yield from mem_read(dut, dst_word - 1, 1)), [dst_word - 1])
+            self.assertEqual((yield from mem_read(dut, dst_word + words, 1)), [dst_word + words])
+
+        dut = DMAMem2MemDUT()
+        run_simulation(dut, generator(dut))
+
+    def dma_fill_test(self, dst_word, words, fill_value):
+        def generator(dut):
+            done = yield from dma_run(dut.dma, dst=4*dst_word, src=0, length=4*words,
+                fill=1, fill_value=fill_value)
+            self.assertTrue(done)
+            # Filled words.
+            self.assertEqual((yield from mem_read(dut, dst_word, words)), [fill_value]*words)
+            # Words around the destination are untouched.
+            self.assertEqual((yield from mem_read(dut, dst_word - 1, 1)), [dst_word - 1])
+            self.assertEqual((yield from mem_read(dut, dst_word + words, 1)), [dst_word + words])
+
+        dut = DMAMem2MemDUT()
+        run_simulation(dut, generator(dut))
+
+    def test_copy(self):
+        self.dma_copy_test(src_word=16, dst_word=128, words=8)
+
+    def test_copy_one_word(self):
+        self.dma_copy_test(src_word=16, dst_word=128, words=1)
+
+    def test_copy_longer_than_fifo(self):
+        self.dma_copy_test(src_word=16, dst_word=128, words=64)
+
+    def test_fill(self):
+        self.dma_fill_test(dst_word=128, words=8, fill_value=0xabababab)
+
+    def test_fill_one_word(self):
+        self.dma_fill_test(dst_word=128, words=1, fill_value=0x5a5a5a5a)
+
+    def test_fill_longer_than_fifo(self):
+        self.dma_fill_test(dst_word=128, words=64, fill_value=0x00000000)
+
+    def test_fill_then_copy(self):
+        def generator(dut):
+            # Fill, then copy: the copy must use the read data, not the fill value.
+            done = yield from dma_run(dut.dma, dst=4*128, src=0, length=4*16,
+                fill=1, fill_value=0xffffffff)
+            self.assertTrue(done)
+            done = yield from dma_run(dut.dma, dst=4*128, src=4*32, length=4*8)
+            self.assertTrue(done)
+            self.assertEqual((yield from mem_read(dut, 128, 16)),
+                list(range(32, 40)) + [0xffffffff]*8)
+
+        dut = DMAMem2MemDUT()
+        run_simulation(dut, generator(dut))